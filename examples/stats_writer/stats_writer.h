@@ -11,6 +11,11 @@
  * After the program was run, the stats are formatted as a RESULT line using
  * get(), which can be outputted to a file or stdout.
  *
+ * For experiments emitting many records, stats_binary_stream writes them as
+ * compact binary records instead, which keep numbers in their native type and
+ * name each key only once. IMPORT-DATA recognizes such files by their magic
+ * bytes. The format is described in src/binresult.h.
+ *
  ******************************************************************************
  * Copyright (C) 2012-2014 Timo Bingmann <tb@panthema.net>
  *
@@ -31,8 +36,13 @@
 #ifndef SQLPLOTS_STATS_WRITER_H
 #define SQLPLOTS_STATS_WRITER_H
 
+#include <climits>
+#include <cstring>
+#include <map>
+#include <ostream>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include <unistd.h>
 #include <time.h>
@@ -43,10 +53,68 @@
  */
 class stats_writer
 {
+public:
+
+    //! A collected key=value pair. Values consisting of a single number keep
+    //! their type: 'i' for integers, 'd' for floating point, 's' for text.
+    struct field
+    {
+        std::string key;
+        char type;
+        long long ival;
+        double dval;
+        std::string sval;
+
+        //! Return value as text, formatted like an ostream does.
+        std::string text() const
+        {
+            if (type == 's') return sval;
+            std::ostringstream vstr;
+            if (type == 'i') vstr << ival; else vstr << dval;
+            return vstr.str();
+        }
+
+        //! Set value as text
+        void set(const std::string& v)
+        {
+            type = 's', sval = v;
+        }
+
+        //! Set value from a number or other streamable type.
+        template <typename ValueType>
+        void set(const ValueType& v)
+        {
+            std::ostringstream vstr;
+            vstr << v;
+            set(vstr.str());
+        }
+
+        void set(short v) { type = 'i', ival = v; }
+        void set(int v) { type = 'i', ival = v; }
+        void set(long v) { type = 'i', ival = v; }
+        void set(long long v) { type = 'i', ival = v; }
+        void set(unsigned short v) { type = 'i', ival = v; }
+        void set(unsigned int v) { type = 'i', ival = v; }
+        void set(float v) { type = 'd', dval = v; }
+        void set(double v) { type = 'd', dval = v; }
+
+        void set(unsigned long v)
+        {
+            if (v <= (unsigned long)LLONG_MAX) type = 'i', ival = v;
+            else set<unsigned long>(v);
+        }
+
+        void set(unsigned long long v)
+        {
+            if (v <= (unsigned long long)LLONG_MAX) type = 'i', ival = v;
+            else set<unsigned long long>(v);
+        }
+    };
+
 protected:
 
     //! All collected key=value values.
-    std::ostringstream  m_line;
+    std::vector<field> m_fields;
 
     //! An internal class to collect key=value pairs as a sequence of >> and <<
     //! operator calls.
@@ -56,27 +124,40 @@ protected:
         //! Reference to parent stats writer object
         class stats_writer& m_sw;
 
-        //! Collected key and value string items
-        std::string m_key, m_value;
+        //! Collected key and value
+        field m_field;
+
+        //! Number of value items collected
+        size_t m_items;
 
     public:
 
         //! Start entry collection for the given key
         entry(stats_writer& sw, const std::string& key)
-            : m_sw(sw), m_key(key)
-        { }
+            : m_sw(sw), m_items(0)
+        {
+            m_field.key = key;
+            m_field.set(std::string());
+        }
 
         //! Collect more information about the value
         entry& operator << (const std::string& v)
         {
-            m_value += v;
+            m_field.set(m_field.text() + v);
+            ++m_items;
             return *this;
         }
 
-        //! Collect more information about the value
+        //! Collect more information about the value, a single number keeps
+        //! its type.
         template <typename ValueType>
         entry& operator << (const ValueType& v)
         {
+            if (m_items == 0) {
+                m_field.set(v);
+                ++m_items;
+                return *this;
+            }
             std::ostringstream vstr;
             vstr << v;
             return operator << (vstr.str());
@@ -87,16 +168,17 @@ protected:
         entry operator >> (const ValueType& v)
         {
             // put key=value into writer before returning next entry
-            m_sw.put(m_key, m_value);
-            m_key.clear(); m_value.clear();
+            m_sw.put_field(m_field);
+            m_field.key.clear(); m_field.set(std::string());
+            m_items = 0;
             return m_sw.operator >> (v);
         }
 
         //! Output key=value to stats writer for the last entry
         ~entry()
         {
-            if (m_key.size() || m_value.size())
-                m_sw.put(m_key, m_value);
+            if (m_field.key.size() || m_field.text().size())
+                m_sw.put_field(m_field);
         }
     };
 
@@ -105,7 +187,13 @@ public:
     //! Clear all data in the stats writer.
     void clear()
     {
-        m_line.str("");
+        m_fields.clear();
+    }
+
+    //! Return all collected key=value pairs.
+    const std::vector<field>& fields() const
+    {
+        return m_fields;
     }
 
     //! Append a (key,value) pair as ">> key << value << more"
@@ -123,47 +211,75 @@ public:
         return operator >> (kstr.str());
     }
 
-    //! Append a (key,value) pair as strings
-    stats_writer& put(const std::string& k, const std::string& v)
+    //! Append a collected (key,value) pair
+    stats_writer& put_field(const field& f)
     {
 #if _OPENMP
 #pragma omp critical
 #endif
-        m_line << '\t' << k << '=' << v;
+        m_fields.push_back(f);
         return *this;
     }
 
-    //! Append a (key,value) pair with automatic conversion to strings
+    //! Append a (key,value) pair as strings
+    stats_writer& put(const std::string& k, const std::string& v)
+    {
+        field f;
+        f.key = k; f.set(v);
+        return put_field(f);
+    }
+
+    //! Append a (key,value) pair, keeping the type of numbers and converting
+    //! other values to strings
     template <typename KeyType, typename ValueType>
     stats_writer& put(const KeyType& k, const ValueType& v)
     {
-        std::ostringstream kstr, vstr;
-        kstr << k; vstr << v;
-        return put(kstr.str(), vstr.str());
+        std::ostringstream kstr;
+        kstr << k;
+
+        field f;
+        f.key = kstr.str(); f.set(v);
+        return put_field(f);
     }
 
-    //! Return RESULT string for outputting.
-    std::string get() const
+    //! Return current date and time and the hostname, which are output first.
+    static std::vector<field> get_header()
     {
-        std::ostringstream out;
-        out << "RESULT";
-
-        // output date, time and hostname
+        std::vector<field> header(2);
 
         char datetime[64];
         time_t tnow = time(NULL);
 
         strftime(datetime,sizeof(datetime),"%Y-%m-%d %H:%M:%S", localtime(&tnow));
-        out << "\tdatetime=" << datetime;
+        header[0].key = "datetime";
+        header[0].set(std::string(datetime));
 
         char hostname[128];
         gethostname(hostname, sizeof(hostname));
 
-        out << "\thost=" << hostname;
+        header[1].key = "host";
+        header[1].set(std::string(hostname));
+
+        return header;
+    }
+
+    //! Return RESULT string for outputting.
+    std::string get() const
+    {
+        std::ostringstream out;
+        out << "RESULT";
+
+        // output date, time and hostname
+
+        std::vector<field> header = get_header();
+
+        for (size_t i = 0; i < header.size(); ++i)
+            out << '\t' << header[i].key << '=' << header[i].text();
 
         // output collected key=values
 
-        out << m_line.str();
+        for (size_t i = 0; i < m_fields.size(); ++i)
+            out << '\t' << m_fields[i].key << '=' << m_fields[i].text();
 
         return out.str();
     }
@@ -175,4 +291,113 @@ public:
     }
 };
 
+/*!
+ * Output stream of binary RESULT records. The magic bytes are written first,
+ * then each key name once in a dictionary record when it first occurs, and
+ * each stats_writer as a row record of key ids and typed values.
+ */
+class stats_binary_stream
+{
+protected:
+    //! Output stream, should be opened in binary mode
+    std::ostream& m_os;
+
+    //! Ids of keys already written
+    std::map<std::string, unsigned int> m_keys;
+
+    //! Buffer of the current record
+    std::string m_record;
+
+    //! Append little-endian integer of given bytes to a string
+    static void append_le(std::string& s, unsigned long long v, int bytes)
+    {
+        for (int b = 0; b < bytes; ++b)
+            s += (char)(v >> (8 * b));
+    }
+
+    //! Append little-endian integer of given bytes to the record
+    void put_le(unsigned long long v, int bytes)
+    {
+        append_le(m_record, v, bytes);
+    }
+
+    //! Write record buffer prefixed with its length
+    void write_record()
+    {
+        std::string length;
+        append_le(length, m_record.size(), 4);
+        m_os << length << m_record;
+    }
+
+    //! Return id of key, writing a dictionary record if it is new
+    unsigned int key_id(const std::string& key)
+    {
+        std::map<std::string, unsigned int>::const_iterator it = m_keys.find(key);
+        if (it != m_keys.end()) return it->second;
+
+        unsigned int id = m_keys.size();
+        m_keys[key] = id;
+
+        m_record = 'K';
+        put_le(id, 4);
+        m_record += key;
+        write_record();
+
+        return id;
+    }
+
+    //! Append a field's key id and typed value to the record
+    void put_field(unsigned int id, const stats_writer::field& f)
+    {
+        put_le(id, 4);
+        m_record += f.type;
+
+        if (f.type == 'i') {
+            put_le(f.ival, 8);
+        }
+        else if (f.type == 'd') {
+            unsigned long long bits;
+            memcpy(&bits, &f.dval, sizeof(bits));
+            put_le(bits, 8);
+        }
+        else {
+            put_le(f.sval.size(), 4);
+            m_record += f.sval;
+        }
+    }
+
+public:
+    //! Start binary stream by writing the magic bytes
+    explicit stats_binary_stream(std::ostream& os)
+        : m_os(os)
+    {
+        m_os.write("SQLPLOTB", 8);
+    }
+
+    //! Write the stats of a writer as one row record
+    stats_binary_stream& operator << (const stats_writer& sw)
+    {
+        std::vector<stats_writer::field> header = stats_writer::get_header();
+        const std::vector<stats_writer::field>& fields = sw.fields();
+
+        // write dictionary records of new keys before the row
+        std::vector<unsigned int> ids;
+        for (size_t i = 0; i < header.size(); ++i)
+            ids.push_back(key_id(header[i].key));
+        for (size_t i = 0; i < fields.size(); ++i)
+            ids.push_back(key_id(fields[i].key));
+
+        m_record = 'R';
+        put_le(ids.size(), 4);
+
+        for (size_t i = 0; i < header.size(); ++i)
+            put_field(ids[i], header[i]);
+        for (size_t i = 0; i < fields.size(); ++i)
+            put_field(ids[header.size() + i], fields[i]);
+
+        write_record();
+        return *this;
+    }
+};
+
 #endif // SQLPLOTS_STATS_WRITER_H
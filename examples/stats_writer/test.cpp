@@ -23,6 +23,7 @@
 #include "stats_writer.h"
 
 #include <iostream>
+#include <string>
 
 int main(int argc, char *argv[])
 {
@@ -34,7 +35,14 @@ int main(int argc, char *argv[])
        >> "argc" << argc
        >> "argv[0]" << argv[0];
 
-    std::cout << sw;
-    
+    if (argc >= 2 && std::string(argv[1]) == "-b") {
+        // output compact binary record instead of a RESULT line
+        stats_binary_stream bs(std::cout);
+        bs << sw;
+    }
+    else {
+        std::cout << sw;
+    }
+
     return 0;
 }
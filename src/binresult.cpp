@@ -0,0 +1,278 @@
+/******************************************************************************
+ * src/binresult.cpp
+ *
+ * Binary RESULT record format, written by stats_writer's binary mode, and its
+ * decoder used by IMPORT-DATA.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "binresult.h"
+#include "common.h"
+#include "numparse.h"
+
+#include <cstring>
+#include <sstream>
+
+//! magic bytes at the beginning of binary files
+const char BinResultDecoder::magic[8] = { 'S', 'Q', 'L', 'P', 'L', 'O', 'T', 'B' };
+
+//! read little-endian 32-bit integer
+static inline uint32_t read_le32(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t)u[0] | ((uint32_t)u[1] << 8) |
+           ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+}
+
+//! read little-endian 64-bit integer
+static inline uint64_t read_le64(const char* p)
+{
+    return (uint64_t)read_le32(p) | ((uint64_t)read_le32(p + 4) << 32);
+}
+
+//! append a value in host byte order to a decoded row
+template <typename Type>
+static inline void append_host(std::string& row, const Type& v)
+{
+    row.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+//! read a value in host byte order from a decoded row
+template <typename Type>
+static inline Type read_host(const char* p)
+{
+    Type v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+//! check if data starts with the magic bytes
+bool BinResultDecoder::is_binary(const char* data, size_t size)
+{
+    return size >= sizeof(magic) && memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+//! decode the record at the beginning of data. Returns the record's size, or
+//! zero if data contains no complete record. If it is a row, row references
+//! the decoded row until the next call, otherwise it is empty. Throws on
+//! malformed records.
+size_t BinResultDecoder::decode(const char* data, size_t size, StringRef& row)
+{
+    row = StringRef();
+
+    // a magic starts a new key dictionary
+    if (is_binary(data, size)) {
+        m_keys.clear();
+        return sizeof(magic);
+    }
+
+    if (size < 4) return 0;
+
+    uint32_t length = read_le32(data);
+    if (length == 0)
+        OUT_THROW("Invalid binary RESULT record of length zero.");
+
+    if (size - 4 < length) return 0;
+
+    const char* p = data + 5, * end = data + 4 + length;
+
+    if (data[4] == R_KEY)
+    {
+        if (end - p < 4)
+            OUT_THROW("Invalid binary RESULT key record.");
+
+        // keys are numbered consecutively, either redefine one or add the next
+        uint32_t id = read_le32(p);
+        if (id > m_keys.size())
+            OUT_THROW("Invalid binary RESULT key record.");
+
+        KeyTable::id_type key = KeyTable::intern(StringRef(p + 4, end - p - 4));
+
+        if (id == m_keys.size())
+            m_keys.push_back(key);
+        else
+            m_keys[id] = key;
+    }
+    else if (data[4] == R_ROW)
+    {
+        if (end - p < 4)
+            OUT_THROW("Invalid binary RESULT row record.");
+
+        uint32_t count = read_le32(p);
+        p += 4;
+
+        m_row.assign(1, '\0');
+
+        // keys used in the row, to make duplicates unique like in text lines
+        static thread_local std::vector<bool> seen;
+        std::vector<KeyTable::id_type> used;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (end - p < 5)
+                OUT_THROW("Truncated binary RESULT row record.");
+
+            uint32_t fid = read_le32(p);
+            if (fid >= m_keys.size() || m_keys[fid] == KeyTable::id_type(-1))
+                OUT_THROW("Binary RESULT row uses undefined key " << fid);
+
+            KeyTable::id_type id = m_keys[fid];
+            char tag = p[4];
+            p += 5;
+
+            for (size_t num = 1; id < seen.size() && seen[id]; ++num)
+            {
+                std::ostringstream nkey;
+                nkey << KeyTable::name(m_keys[fid]) << num;
+                id = KeyTable::intern(nkey.str());
+            }
+
+            if (id >= seen.size()) seen.resize(id + 1);
+            seen[id] = true;
+            used.push_back(id);
+
+            append_host(m_row, id);
+            m_row += tag;
+
+            if (tag == V_INTEGER || tag == V_DOUBLE)
+            {
+                if (end - p < 8)
+                    OUT_THROW("Truncated binary RESULT row record.");
+
+                append_host(m_row, read_le64(p));
+                p += 8;
+            }
+            else if (tag == V_TEXT)
+            {
+                if (end - p < 4 || (size_t)(end - p - 4) < read_le32(p))
+                    OUT_THROW("Truncated binary RESULT row record.");
+
+                uint32_t len = read_le32(p);
+                append_host(m_row, len);
+                m_row.append(p + 4, len);
+                p += 4 + len;
+            }
+            else
+            {
+                OUT_THROW("Binary RESULT row has unknown value tag " << tag);
+            }
+        }
+
+        for (size_t i = 0; i < used.size(); ++i)
+            seen[used[i]] = false;
+
+        if (p != end)
+            OUT_THROW("Binary RESULT row record has trailing bytes.");
+
+        row = StringRef(m_row);
+    }
+
+    // other record types are skipped for forward compatibility
+    return 4 + length;
+}
+
+//! split a decoded row into keys, values and parameter types.
+void BinResultDecoder::split_row(const StringRef& row, klist_type& keys,
+                                 vlist_type& values,
+                                 SqlStatementImpl::ptypes_type& ptypes)
+{
+    keys.clear(), values.clear(), ptypes.clear();
+
+    const char* p = row.data() + 1, * end = row.end();
+
+    while (p != end)
+    {
+        keys.push_back(read_host<KeyTable::id_type>(p));
+        char tag = p[sizeof(KeyTable::id_type)];
+        p += sizeof(KeyTable::id_type) + 1;
+
+        if (tag == V_TEXT)
+        {
+            uint32_t len = read_host<uint32_t>(p);
+            values.push_back(StringRef(p + 4, len));
+            ptypes.push_back(SqlStatementImpl::PARAM_TEXT);
+            p += 4 + len;
+        }
+        else
+        {
+            values.push_back(StringRef(p, 8));
+            ptypes.push_back(tag == V_INTEGER
+                             ? SqlStatementImpl::PARAM_NATIVE_INTEGER
+                             : SqlStatementImpl::PARAM_NATIVE_DOUBLE);
+            p += 8;
+        }
+    }
+}
+
+//! return field type of a value of a decoded row
+FieldSet::fieldtype
+BinResultDecoder::detect(const StringRef& value,
+                         SqlStatementImpl::param_type ptype)
+{
+    switch (ptype)
+    {
+    case SqlStatementImpl::PARAM_NATIVE_INTEGER:
+        return FieldSet::T_INTEGER;
+    case SqlStatementImpl::PARAM_NATIVE_DOUBLE:
+        return FieldSet::T_DOUBLE;
+    default:
+        return FieldSet::detect(value);
+    }
+}
+
+//! format a value of a decoded row as text
+std::string
+BinResultDecoder::format(const StringRef& value,
+                         SqlStatementImpl::param_type ptype)
+{
+    char buffer[32];
+
+    switch (ptype)
+    {
+    case SqlStatementImpl::PARAM_NATIVE_INTEGER:
+        return std::string(
+            buffer, snprintf(buffer, sizeof(buffer), "%lld",
+                             (long long)read_host<int64_t>(value.data())));
+    case SqlStatementImpl::PARAM_NATIVE_DOUBLE:
+        return std::string(
+            buffer, format_double(read_host<double>(value.data()), buffer));
+    default:
+        return value.str();
+    }
+}
+
+//! format a decoded row as a RESULT line, for messages
+std::string BinResultDecoder::format_row(const StringRef& row)
+{
+    klist_type keys;
+    vlist_type values;
+    SqlStatementImpl::ptypes_type ptypes;
+    split_row(row, keys, values, ptypes);
+
+    std::string line = "RESULT";
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        line += '\t';
+        line += KeyTable::name(keys[i]);
+        line += '=';
+        line += format(values[i], ptypes[i]);
+    }
+
+    return line;
+}
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * src/binresult.h
+ *
+ * Binary RESULT record format, written by stats_writer's binary mode, and its
+ * decoder used by IMPORT-DATA.
+ *
+ * A binary file starts with the eight magic bytes "SQLPLOTB", followed by
+ * length-prefixed records. All integers are little-endian.
+ *
+ *   record := length:u32 type:u8 payload    (length counts type and payload)
+ *
+ *   type 'K': id:u32 name            defines key id as name (rest of record)
+ *   type 'R': count:u32 { id:u32 tag:u8 value }   one row of typed values
+ *
+ *   tag 'i': int64, tag 'd': IEEE double, tag 's': length:u32 bytes
+ *
+ * Key ids are only valid within the file, or up to the next magic, which
+ * starts a new key dictionary. Hence binary files of separate runs may simply
+ * be concatenated.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef BINRESULT_HEADER
+#define BINRESULT_HEADER
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "fieldset.h"
+#include "keytable.h"
+#include "sql.h"
+#include "stringref.h"
+
+/*!
+ * Decoder of binary RESULT records. Row records are translated into decoded
+ * rows, which refer to keys by KeyTable ids and can be cached and split like
+ * text lines. A decoded row starts with a zero byte, followed by the fields
+ * as id:u32 tag:u8 value, with values encoded as in the file.
+ */
+class BinResultDecoder
+{
+public:
+    //! magic bytes at the beginning of binary files
+    static const char magic[8];
+
+    //! types of records
+    enum record_type { R_KEY = 'K', R_ROW = 'R' };
+
+    //! tags of typed values
+    enum value_tag { V_INTEGER = 'i', V_DOUBLE = 'd', V_TEXT = 's' };
+
+    //! list of key ids
+    typedef std::vector<KeyTable::id_type> klist_type;
+
+    //! list of values
+    typedef std::vector<StringRef> vlist_type;
+
+protected:
+    //! KeyTable ids of the file's key ids
+    std::vector<KeyTable::id_type> m_keys;
+
+    //! buffer of the last decoded row
+    std::string m_row;
+
+public:
+    //! check if data starts with the magic bytes
+    static bool is_binary(const char* data, size_t size);
+
+    //! check if a line is a decoded row
+    static bool is_row(const StringRef& line)
+    {
+        return line.size() != 0 && line.data()[0] == 0;
+    }
+
+    //! decode the record at the beginning of data. Returns the record's size,
+    //! or zero if data contains no complete record. If it is a row, row
+    //! references the decoded row until the next call, otherwise it is empty.
+    //! Throws on malformed records.
+    size_t decode(const char* data, size_t size, StringRef& row);
+
+    //! split a decoded row into keys, values and parameter types. Numeric
+    //! values reference their native eight bytes and have type
+    //! PARAM_NATIVE_INTEGER or PARAM_NATIVE_DOUBLE.
+    static void split_row(const StringRef& row, klist_type& keys,
+                          vlist_type& values,
+                          SqlStatementImpl::ptypes_type& ptypes);
+
+    //! return field type of a value of a decoded row
+    static FieldSet::fieldtype
+    detect(const StringRef& value, SqlStatementImpl::param_type ptype);
+
+    //! format a value of a decoded row as text
+    static std::string
+    format(const StringRef& value, SqlStatementImpl::param_type ptype);
+
+    //! format a decoded row as a RESULT line, for messages
+    static std::string format_row(const StringRef& row);
+};
+
+#endif // BINRESULT_HEADER
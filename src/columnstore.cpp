@@ -0,0 +1,444 @@
+/******************************************************************************
+ * src/columnstore.cpp
+ *
+ * Read-only in-memory table of typed columns, which is exposed to SQLite as a
+ * virtual table.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "columnstore.h"
+#include "common.h"
+#include "numparse.h"
+#include "strtools.h"
+
+#include <cstring>
+#include <sstream>
+
+//! create empty store with columns of the field set
+ColumnStore::ColumnStore(const FieldSet& fields)
+    : m_columns(fields.count()), m_rows(0)
+{
+    for (size_t i = 0; i < fields.count(); ++i)
+    {
+        Column& c = m_columns[i];
+
+        c.name = fields.key(i);
+        c.sqltype = FieldSet::sqlname(fields.type(i), SqlDatabase::DB_SQLITE);
+
+        switch (fields.type(i))
+        {
+        case FieldSet::T_INTEGER: c.type = C_INTEGER; break;
+        case FieldSet::T_DOUBLE: c.type = C_DOUBLE; break;
+        default: c.type = C_TEXT; break;
+        }
+    }
+}
+
+//! return pool index of a string, adding it if necessary
+uint32_t ColumnStore::intern(const StringRef& str)
+{
+    std::string key(str.data(), str.size());
+
+    std::unordered_map<std::string, uint32_t>::const_iterator it =
+        m_string_index.find(key);
+    if (it != m_string_index.end()) return it->second;
+
+    uint32_t id = m_strings.size();
+    m_strings.push_back(key);
+    m_string_index.insert(std::make_pair(key, id));
+    return id;
+}
+
+//! append value to column col of the current row
+void ColumnStore::put(size_t col, const StringRef& value)
+{
+    Column& c = m_columns[col];
+    c.null.push_back(false);
+
+    switch (c.type)
+    {
+    case C_INTEGER:
+    {
+        int64_t v = 0;
+        if (!parse_int64(value, v)) c.other[m_rows] = intern(value);
+        c.ints.push_back(v);
+        break;
+    }
+    case C_DOUBLE:
+    {
+        double v = 0;
+        if (!parse_double(value, v)) c.other[m_rows] = intern(value);
+        c.doubles.push_back(v);
+        break;
+    }
+    case C_TEXT:
+        c.strings.push_back(intern(value));
+        break;
+    }
+}
+
+//! append NULL to column col of the current row
+void ColumnStore::put_null(size_t col)
+{
+    Column& c = m_columns[col];
+    c.null.push_back(true);
+
+    switch (c.type)
+    {
+    case C_INTEGER: c.ints.push_back(0); break;
+    case C_DOUBLE: c.doubles.push_back(0); break;
+    case C_TEXT: c.strings.push_back(0); break;
+    }
+}
+
+//! append integer to column col of the current row
+void ColumnStore::put_int64(size_t col, int64_t value)
+{
+    Column& c = m_columns[col];
+
+    switch (c.type)
+    {
+    case C_INTEGER:
+        c.null.push_back(false);
+        c.ints.push_back(value);
+        break;
+    case C_DOUBLE:
+        c.null.push_back(false);
+        c.doubles.push_back((double)value);
+        break;
+    case C_TEXT:
+        put(col, to_str(value));
+        break;
+    }
+}
+
+//! append double to column col of the current row
+void ColumnStore::put_double(size_t col, double value)
+{
+    Column& c = m_columns[col];
+
+    if (c.type == C_DOUBLE) {
+        c.null.push_back(false);
+        c.doubles.push_back(value);
+        return;
+    }
+
+    // a double in an integer column is kept as text, like text values are.
+    char buffer[32];
+    put(col, StringRef(buffer, format_double(value, buffer)));
+}
+
+//! finish the current row
+void ColumnStore::end_row()
+{
+    ++m_rows;
+
+    for (size_t i = 0; i < m_columns.size(); ++i)
+    {
+        if (m_columns[i].null.size() != m_rows)
+            OUT_THROW("Row " << m_rows << " has a wrong number of columns.");
+    }
+}
+
+//! return CREATE TABLE statement declaring the columns to SQLite
+std::string ColumnStore::declare() const
+{
+    std::ostringstream os;
+    os << "CREATE TABLE x (";
+
+    for (size_t i = 0; i < m_columns.size(); ++i)
+    {
+        if (i != 0) os << ", ";
+        os << '"' << replace_all(m_columns[i].name, "\"", "\"\"") << "\" "
+           << m_columns[i].sqltype;
+    }
+
+    os << ")";
+    return os.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! register store for CREATE VIRTUAL TABLE, returns its module argument
+std::string ColumnStoreRegistry::publish(
+    const boost::shared_ptr<ColumnStore>& store)
+{
+    std::string id = "store" + to_str(++m_counter);
+    m_stores[id] = store;
+    return id;
+}
+
+//! remove store registered with publish()
+void ColumnStoreRegistry::unpublish(const std::string& id)
+{
+    m_stores.erase(id);
+}
+
+//! return store registered with publish(), or an empty pointer
+boost::shared_ptr<ColumnStore>
+ColumnStoreRegistry::find(const std::string& id) const
+{
+    map_type::const_iterator it = m_stores.find(id);
+    if (it == m_stores.end()) return boost::shared_ptr<ColumnStore>();
+    return it->second;
+}
+
+//! virtual table instance referencing a store
+struct ColumnVtab : public sqlite3_vtab
+{
+    //! registry of the connection
+    ColumnStoreRegistry* registry;
+
+    //! module argument identifying the store
+    std::string id;
+
+    //! table data
+    boost::shared_ptr<ColumnStore> store;
+};
+
+//! cursor iterating over the rows of a store
+struct ColumnCursor : public sqlite3_vtab_cursor
+{
+    //! current row
+    size_t row;
+};
+
+//! xCreate and xConnect: look up the store and declare its columns
+static int vtab_connect(sqlite3* db, void* aux, int argc,
+                        const char* const* argv, sqlite3_vtab** vtab,
+                        char** err)
+{
+    if (argc < 4) {
+        *err = sqlite3_mprintf("sqlplot_columns: missing store argument");
+        return SQLITE_ERROR;
+    }
+
+    ColumnStoreRegistry* registry = static_cast<ColumnStoreRegistry*>(aux);
+    boost::shared_ptr<ColumnStore> store = registry->find(argv[3]);
+
+    if (!store) {
+        *err = sqlite3_mprintf("sqlplot_columns: unknown store %s", argv[3]);
+        return SQLITE_ERROR;
+    }
+
+    int rc = sqlite3_declare_vtab(db, store->declare().c_str());
+    if (rc != SQLITE_OK) return rc;
+
+    ColumnVtab* t = new ColumnVtab;
+    memset(static_cast<sqlite3_vtab*>(t), 0, sizeof(sqlite3_vtab));
+    t->registry = registry;
+    t->id = argv[3];
+    t->store = store;
+
+    *vtab = t;
+    return SQLITE_OK;
+}
+
+//! xBestIndex: only full scans are supported
+static int vtab_best_index(sqlite3_vtab* vtab, sqlite3_index_info* info)
+{
+    ColumnVtab* t = static_cast<ColumnVtab*>(vtab);
+
+    info->estimatedCost = (double)t->store->rows();
+    info->estimatedRows = t->store->rows();
+    return SQLITE_OK;
+}
+
+//! xDisconnect: release table instance
+static int vtab_disconnect(sqlite3_vtab* vtab)
+{
+    delete static_cast<ColumnVtab*>(vtab);
+    return SQLITE_OK;
+}
+
+//! xDestroy: table is dropped, release the store
+static int vtab_destroy(sqlite3_vtab* vtab)
+{
+    ColumnVtab* t = static_cast<ColumnVtab*>(vtab);
+    t->registry->unpublish(t->id);
+    delete t;
+    return SQLITE_OK;
+}
+
+//! xOpen: create cursor
+static int vtab_open(sqlite3_vtab* /* vtab */, sqlite3_vtab_cursor** cursor)
+{
+    ColumnCursor* c = new ColumnCursor;
+    memset(static_cast<sqlite3_vtab_cursor*>(c), 0, sizeof(sqlite3_vtab_cursor));
+    c->row = 0;
+
+    *cursor = c;
+    return SQLITE_OK;
+}
+
+//! xClose: free cursor
+static int vtab_close(sqlite3_vtab_cursor* cursor)
+{
+    delete static_cast<ColumnCursor*>(cursor);
+    return SQLITE_OK;
+}
+
+//! xFilter: start scan at the first row
+static int vtab_filter(sqlite3_vtab_cursor* cursor, int /* idxNum */,
+                       const char* /* idxStr */, int /* argc */,
+                       sqlite3_value** /* argv */)
+{
+    static_cast<ColumnCursor*>(cursor)->row = 0;
+    return SQLITE_OK;
+}
+
+//! xNext: advance to next row
+static int vtab_next(sqlite3_vtab_cursor* cursor)
+{
+    ++static_cast<ColumnCursor*>(cursor)->row;
+    return SQLITE_OK;
+}
+
+//! xEof: check for end of rows
+static int vtab_eof(sqlite3_vtab_cursor* cursor)
+{
+    ColumnCursor* c = static_cast<ColumnCursor*>(cursor);
+    return c->row >= static_cast<ColumnVtab*>(c->pVtab)->store->rows();
+}
+
+//! xColumn: return value of a column in the current row
+static int vtab_column(sqlite3_vtab_cursor* cursor, sqlite3_context* ctx,
+                       int col)
+{
+    ColumnCursor* c = static_cast<ColumnCursor*>(cursor);
+    const ColumnStore& store = *static_cast<ColumnVtab*>(c->pVtab)->store;
+    const ColumnStore::Column& column = store.column(col);
+
+    if (column.null[c->row]) {
+        sqlite3_result_null(ctx);
+        return SQLITE_OK;
+    }
+
+    if (!column.other.empty())
+    {
+        std::map<size_t, uint32_t>::const_iterator it = column.other.find(c->row);
+        if (it != column.other.end()) {
+            const std::string& s = store.string(it->second);
+            sqlite3_result_text(ctx, s.data(), s.size(), SQLITE_STATIC);
+            return SQLITE_OK;
+        }
+    }
+
+    switch (column.type)
+    {
+    case ColumnStore::C_INTEGER:
+        sqlite3_result_int64(ctx, column.ints[c->row]);
+        break;
+    case ColumnStore::C_DOUBLE:
+        sqlite3_result_double(ctx, column.doubles[c->row]);
+        break;
+    case ColumnStore::C_TEXT:
+    {
+        const std::string& s = store.string(column.strings[c->row]);
+        sqlite3_result_text(ctx, s.data(), s.size(), SQLITE_STATIC);
+        break;
+    }
+    }
+
+    return SQLITE_OK;
+}
+
+//! xRowid: rows are numbered from one
+static int vtab_rowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid)
+{
+    *rowid = static_cast<ColumnCursor*>(cursor)->row + 1;
+    return SQLITE_OK;
+}
+
+//! fill method table of the read-only sqlplot_columns module
+static sqlite3_module make_module()
+{
+    sqlite3_module module;
+    memset(&module, 0, sizeof(module));
+
+    module.iVersion = 0;
+    module.xCreate = vtab_connect;
+    module.xConnect = vtab_connect;
+    module.xBestIndex = vtab_best_index;
+    module.xDisconnect = vtab_disconnect;
+    module.xDestroy = vtab_destroy;
+    module.xOpen = vtab_open;
+    module.xClose = vtab_close;
+    module.xFilter = vtab_filter;
+    module.xNext = vtab_next;
+    module.xEof = vtab_eof;
+    module.xColumn = vtab_column;
+    module.xRowid = vtab_rowid;
+
+    return module;
+}
+
+//! register the sqlplot_columns module of this registry with an SQLite
+//! connection, which must be closed before the registry is destroyed.
+int ColumnStoreRegistry::register_module(sqlite3* db)
+{
+    static const sqlite3_module module = make_module();
+
+    return sqlite3_create_module(db, "sqlplot_columns", &module, this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! start loading into the store, which already has the table's columns
+ColumnStoreLoad::ColumnStoreLoad(const std::string& table,
+                                 const boost::shared_ptr<ColumnStore>& store)
+    : SqlBulkLoadImpl(table, store->cols()),
+      m_store(store), m_col(0)
+{
+}
+
+//! Append a text cell to the current row.
+void ColumnStoreLoad::put(const StringRef& value)
+{
+    m_store->put(m_col++, value);
+}
+
+//! Append a NULL cell to the current row.
+void ColumnStoreLoad::put_null()
+{
+    m_store->put_null(m_col++);
+}
+
+//! Append an integer cell to the current row.
+void ColumnStoreLoad::put_int64(int64_t value)
+{
+    m_store->put_int64(m_col++, value);
+}
+
+//! Append a floating point cell to the current row.
+void ColumnStoreLoad::put_double(double value)
+{
+    m_store->put_double(m_col++, value);
+}
+
+//! Finish the current row.
+void ColumnStoreLoad::end_row()
+{
+    m_store->end_row();
+    m_col = 0;
+}
+
+//! Nothing to flush, rows are visible immediately.
+void ColumnStoreLoad::finish()
+{
+}
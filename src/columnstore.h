@@ -0,0 +1,213 @@
+/******************************************************************************
+ * src/columnstore.h
+ *
+ * Read-only in-memory table of typed columns, which is exposed to SQLite as a
+ * virtual table.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef COLUMNSTORE_HEADER
+#define COLUMNSTORE_HEADER
+
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <sqlite3.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "fieldset.h"
+#include "sql.h"
+#include "stringref.h"
+
+/*!
+ * Table stored column by column: integer and floating point columns are kept
+ * as contiguous arrays of native values, text columns as indexes into a pool
+ * of distinct strings. Values are converted once when appended, like SQLite's
+ * column affinity would do for the detected field types.
+ */
+class ColumnStore
+{
+public:
+    //! storage type of a column
+    enum coltype { C_INTEGER, C_DOUBLE, C_TEXT };
+
+    //! one column of the table
+    struct Column
+    {
+        //! field name
+        std::string name;
+
+        //! declared SQL type, determines the affinity in SQLite
+        std::string sqltype;
+
+        //! storage type of values
+        coltype type;
+
+        //! values of C_INTEGER columns
+        std::vector<int64_t> ints;
+
+        //! values of C_DOUBLE columns
+        std::vector<double> doubles;
+
+        //! string pool indexes of C_TEXT columns
+        std::vector<uint32_t> strings;
+
+        //! flags of NULL values
+        std::vector<bool> null;
+
+        //! rare values which are not convertible to the column's type, kept
+        //! as text and mapped from row to string pool index.
+        std::map<size_t, uint32_t> other;
+    };
+
+protected:
+    //! columns of the table
+    std::vector<Column> m_columns;
+
+    //! number of complete rows
+    size_t m_rows;
+
+    //! pool of distinct strings, a deque keeps their addresses stable
+    std::deque<std::string> m_strings;
+
+    //! map of strings to their pool index
+    std::unordered_map<std::string, uint32_t> m_string_index;
+
+    //! return pool index of a string, adding it if necessary
+    uint32_t intern(const StringRef& str);
+
+public:
+    //! create empty store with columns of the field set
+    explicit ColumnStore(const FieldSet& fields);
+
+    //! number of complete rows
+    size_t rows() const
+    {
+        return m_rows;
+    }
+
+    //! number of columns
+    size_t cols() const
+    {
+        return m_columns.size();
+    }
+
+    //! return column i
+    const Column& column(size_t i) const
+    {
+        return m_columns[i];
+    }
+
+    //! return string with given pool index
+    const std::string& string(uint32_t id) const
+    {
+        return m_strings[id];
+    }
+
+    //! append value to column col of the current row
+    void put(size_t col, const StringRef& value);
+
+    //! append NULL to column col of the current row
+    void put_null(size_t col);
+
+    //! append integer to column col of the current row
+    void put_int64(size_t col, int64_t value);
+
+    //! append double to column col of the current row
+    void put_double(size_t col, double value);
+
+    //! finish the current row
+    void end_row();
+
+    //! return CREATE TABLE statement declaring the columns to SQLite
+    std::string declare() const;
+};
+
+//! Stores of the virtual tables of one SQLite connection, by module argument.
+//! A store is kept until its table is dropped or the connection is closed,
+//! since SQLite may connect to a table again when it reloads the schema.
+class ColumnStoreRegistry
+{
+protected:
+    //! type of map of stores
+    typedef std::map<std::string, boost::shared_ptr<ColumnStore> > map_type;
+
+    //! stores waiting for or attached to virtual tables
+    map_type m_stores;
+
+    //! counter of published stores
+    size_t m_counter;
+
+public:
+    //! create empty registry
+    ColumnStoreRegistry() : m_counter(0) { }
+
+    //! register store for CREATE VIRTUAL TABLE, returns its module argument
+    std::string publish(const boost::shared_ptr<ColumnStore>& store);
+
+    //! remove store registered with publish()
+    void unpublish(const std::string& id);
+
+    //! return store registered with publish(), or an empty pointer
+    boost::shared_ptr<ColumnStore> find(const std::string& id) const;
+
+    //! register the sqlplot_columns module of this registry with an SQLite
+    //! connection, which must be closed before the registry is destroyed.
+    int register_module(sqlite3* db);
+};
+
+//! Bulk loader filling a ColumnStore row by row
+class ColumnStoreLoad : public SqlBulkLoadImpl
+{
+protected:
+    //! store to fill
+    boost::shared_ptr<ColumnStore> m_store;
+
+    //! next column of the current row
+    size_t m_col;
+
+public:
+    //! start loading into the store, which already has the table's columns
+    ColumnStoreLoad(const std::string& table,
+                    const boost::shared_ptr<ColumnStore>& store);
+
+    //! Append a text cell to the current row.
+    void put(const StringRef& value);
+
+    //! Append a NULL cell to the current row.
+    void put_null();
+
+    //! Append an integer cell to the current row.
+    void put_int64(int64_t value);
+
+    //! Append a floating point cell to the current row.
+    void put_double(double value);
+
+    //! Finish the current row.
+    void end_row();
+
+    //! Nothing to flush, rows are visible immediately.
+    void finish();
+};
+
+#endif // COLUMNSTORE_HEADER
@@ -23,6 +23,8 @@
 #include "common.h"
 #include "strtools.h"
 
+#include <mutex>
+
 //! verbosity, common global option.
 int gopt_verbose = 0;
 
@@ -129,10 +131,26 @@ bool g_db_connect(const std::string& db_conninfo)
     return false;
 }
 
+//! write a message to std::cerr in one piece, serialized between threads
+void out_write(const std::string& msg)
+{
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::cerr << msg << std::flush;
+}
+
 //! free global SQL database connection
 void g_db_free()
 {
     if (g_db) {
+        size_t hits, misses;
+        g_db->stmt_cache_stats(hits, misses);
+
+        OUTC(gopt_verbose >= 1 && hits + misses != 0,
+             "Statement cache: " << hits << " hits, "
+             << misses << " misses." << std::endl);
+
         delete g_db;
         g_db = NULL;
     }
@@ -49,12 +49,15 @@ extern bool g_db_connect(const std::string& db_conninfo);
 //! free global SQL database connection
 extern void g_db_free();
 
+//! write a message to std::cerr in one piece, serialized between threads
+extern void out_write(const std::string& msg);
+
 #ifdef OUT
 #undef OUT
 #endif
 
-//! conditional debug output
-#define OUTC(dbg,X)   do { if (dbg) { std::cerr << X; } } while(0)
+//! conditional debug output, formatted first to keep messages of threads apart
+#define OUTC(dbg,X)   do { if (dbg) { std::ostringstream out_stream; out_stream << X; out_write(out_stream.str()); } } while(0)
 
 //! write output to std::cerr without newline
 #define OUTX(X)       OUTC(true, X)
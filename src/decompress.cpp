@@ -0,0 +1,494 @@
+/******************************************************************************
+ * src/decompress.cpp
+ *
+ * In-process streaming decompression of gzip, bzip2 and xz files, and a
+ * background thread reading ahead of the consumer.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "decompress.h"
+#include "common.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if HAVE_BZIP2
+#include <bzlib.h>
+#endif
+
+#if HAVE_LZMA
+#include <lzma.h>
+#endif
+
+//! Save file name.
+DecompressImpl::DecompressImpl(const std::string& fname)
+    : m_fname(fname)
+{
+}
+
+//! Close the file.
+DecompressImpl::~DecompressImpl()
+{
+}
+
+//! Return name of the compressed file.
+const std::string& DecompressImpl::fname() const
+{
+    return m_fname;
+}
+
+//! Checks if the given match string is located at the end of this string.
+static inline
+bool ends_with(const std::string& str, const char* match) {
+    size_t match_size = strlen(match);
+    return str.size() >= match_size &&
+           str.compare(str.size() - match_size, match_size, match) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#if HAVE_ZLIB
+
+//! gzip decompression using zlib
+class GzipDecompress : public DecompressImpl
+{
+protected:
+    //! zlib file handle
+    gzFile m_gz;
+
+public:
+    //! Open the file, check m_gz afterwards.
+    GzipDecompress(const std::string& fname)
+        : DecompressImpl(fname)
+    {
+        m_gz = gzopen(fname.c_str(), "rb");
+        if (m_gz) gzbuffer(m_gz, 128 * 1024);
+    }
+
+    //! Close the file.
+    ~GzipDecompress()
+    {
+        if (m_gz) gzclose(m_gz);
+    }
+
+    //! Return true if the file was opened.
+    bool good() const
+    {
+        return m_gz != NULL;
+    }
+
+    //! Read decompressed data, throws on errors.
+    size_t read(char* data, size_t size)
+    {
+        int rb = gzread(m_gz, data, std::min<size_t>(size, 1024 * 1024 * 1024));
+
+        // a truncated file is only reported via gzerror() at the end
+        int errnum = Z_OK;
+        if (rb <= 0) gzerror(m_gz, &errnum);
+
+        if (rb < 0 || errnum != Z_OK)
+        {
+            const char* errmsg = gzerror(m_gz, &errnum);
+            OUT_THROW("Error decompressing " << m_fname << ": " <<
+                      (errnum == Z_ERRNO ? strerror(errno) : errmsg));
+        }
+        return rb;
+    }
+};
+
+#endif // HAVE_ZLIB
+
+////////////////////////////////////////////////////////////////////////////////
+
+#if HAVE_BZIP2
+
+//! bzip2 decompression using libbz2, including concatenated streams.
+class Bzip2Decompress : public DecompressImpl
+{
+protected:
+    //! underlying file
+    FILE* m_file;
+
+    //! libbz2 handle for the current stream
+    BZFILE* m_bz;
+
+    //! input read beyond the end of the previous stream
+    std::vector<char> m_unused;
+
+    //! open the next stream of the file
+    void open_stream()
+    {
+        int bzerror;
+        m_bz = BZ2_bzReadOpen(&bzerror, m_file, 0, 0,
+                              m_unused.data(), m_unused.size());
+        if (bzerror != BZ_OK)
+        {
+            BZ2_bzReadClose(&bzerror, m_bz);
+            m_bz = NULL;
+            OUT_THROW("Error decompressing " << m_fname << ": bzip2 error " <<
+                      bzerror);
+        }
+    }
+
+public:
+    //! Open the file, check m_file afterwards.
+    Bzip2Decompress(const std::string& fname)
+        : DecompressImpl(fname), m_bz(NULL)
+    {
+        m_file = fopen(fname.c_str(), "rb");
+        if (!m_file) return;
+
+        try {
+            open_stream();
+        }
+        catch (...) {
+            fclose(m_file);
+            throw;
+        }
+    }
+
+    //! Close the file.
+    ~Bzip2Decompress()
+    {
+        int bzerror;
+        if (m_bz) BZ2_bzReadClose(&bzerror, m_bz);
+        if (m_file) fclose(m_file);
+    }
+
+    //! Return true if the file was opened.
+    bool good() const
+    {
+        return m_file != NULL;
+    }
+
+    //! Read decompressed data, throws on errors.
+    size_t read(char* data, size_t size)
+    {
+        while (m_bz)
+        {
+            int bzerror;
+            int rb = BZ2_bzRead(&bzerror, m_bz, data,
+                                std::min<size_t>(size, 1024 * 1024 * 1024));
+
+            if (bzerror == BZ_STREAM_END)
+            {
+                // save input of the following stream and restart
+                void* unused;
+                int nunused;
+                BZ2_bzReadGetUnused(&bzerror, m_bz, &unused, &nunused);
+                m_unused.assign((char*)unused, (char*)unused + nunused);
+
+                BZ2_bzReadClose(&bzerror, m_bz);
+                m_bz = NULL;
+
+                if (!m_unused.empty() || ungetc(getc(m_file), m_file) != EOF)
+                    open_stream();
+            }
+            else if (bzerror != BZ_OK)
+            {
+                OUT_THROW("Error decompressing " << m_fname <<
+                          ": bzip2 error " << bzerror);
+            }
+
+            if (rb > 0) return rb;
+        }
+
+        return 0;
+    }
+};
+
+#endif // HAVE_BZIP2
+
+////////////////////////////////////////////////////////////////////////////////
+
+#if HAVE_LZMA
+
+//! xz decompression using liblzma, including concatenated streams.
+class XzDecompress : public DecompressImpl
+{
+protected:
+    //! underlying file
+    FILE* m_file;
+
+    //! liblzma decoder state
+    lzma_stream m_strm;
+
+    //! input buffer
+    std::vector<uint8_t> m_inbuf;
+
+    //! reached end of the stream
+    bool m_end;
+
+public:
+    //! Open the file, check m_file afterwards.
+    XzDecompress(const std::string& fname)
+        : DecompressImpl(fname),
+          m_strm(LZMA_STREAM_INIT), m_inbuf(128 * 1024), m_end(false)
+    {
+        m_file = fopen(fname.c_str(), "rb");
+        if (!m_file) return;
+
+        lzma_ret ret = lzma_stream_decoder(&m_strm, UINT64_MAX,
+                                           LZMA_CONCATENATED);
+        if (ret != LZMA_OK) {
+            fclose(m_file);
+            OUT_THROW("Error decompressing " << m_fname << ": lzma error " << ret);
+        }
+    }
+
+    //! Close the file.
+    ~XzDecompress()
+    {
+        lzma_end(&m_strm);
+        if (m_file) fclose(m_file);
+    }
+
+    //! Return true if the file was opened.
+    bool good() const
+    {
+        return m_file != NULL;
+    }
+
+    //! Read decompressed data, throws on errors.
+    size_t read(char* data, size_t size)
+    {
+        if (m_end) return 0;
+
+        m_strm.next_out = (uint8_t*)data;
+        m_strm.avail_out = size;
+
+        while (true)
+        {
+            if (m_strm.avail_in == 0 && !feof(m_file))
+            {
+                m_strm.next_in = m_inbuf.data();
+                m_strm.avail_in = fread(m_inbuf.data(), 1, m_inbuf.size(), m_file);
+
+                if (ferror(m_file))
+                    OUT_THROW("Error reading " << m_fname << ": " << strerror(errno));
+            }
+
+            lzma_ret ret = lzma_code(
+                &m_strm, feof(m_file) ? LZMA_FINISH : LZMA_RUN);
+
+            size_t produced = size - m_strm.avail_out;
+
+            if (ret == LZMA_STREAM_END) {
+                m_end = true;
+                return produced;
+            }
+            else if (ret != LZMA_OK) {
+                OUT_THROW("Error decompressing " << m_fname << ": lzma error " << ret);
+            }
+
+            if (produced != 0) return produced;
+        }
+    }
+};
+
+#endif // HAVE_LZMA
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! Return true if the file name has an extension which is decompressed
+//! in-process.
+bool DecompressImpl::is_compressed(const std::string& fname)
+{
+#if HAVE_ZLIB
+    if (ends_with(fname, ".gz")) return true;
+#endif
+#if HAVE_BZIP2
+    if (ends_with(fname, ".bz2")) return true;
+#endif
+#if HAVE_LZMA
+    if (ends_with(fname, ".xz")) return true;
+#endif
+    return false;
+}
+
+//! construct a decompressor and check that the file was opened.
+template <typename Decompressor>
+static inline Decompress
+open_decompress(const std::string& fname)
+{
+    boost::shared_ptr<Decompressor> in(new Decompressor(fname));
+    if (!in->good()) {
+        if (errno == 0) errno = EIO;
+        return Decompress();
+    }
+    return in;
+}
+
+//! Open a compressed file for decompression, determining the format from the
+//! file extension.
+Decompress DecompressImpl::open(const std::string& fname)
+{
+    errno = 0;
+
+#if HAVE_ZLIB
+    if (ends_with(fname, ".gz"))
+        return open_decompress<GzipDecompress>(fname);
+#endif
+#if HAVE_BZIP2
+    if (ends_with(fname, ".bz2"))
+        return open_decompress<Bzip2Decompress>(fname);
+#endif
+#if HAVE_LZMA
+    if (ends_with(fname, ".xz"))
+        return open_decompress<XzDecompress>(fname);
+#endif
+
+    return Decompress();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! Decompresses another stream in a background thread into a bounded queue of
+//! blocks, from which read() copies.
+class ReadAheadDecompress : public DecompressImpl
+{
+protected:
+    //! size of blocks read
+    enum { block_size = 256 * 1024 };
+
+    //! maximum number of queued blocks
+    enum { max_blocks = 8 };
+
+    //! decompressor run by the thread
+    Decompress m_in;
+
+    //! lock for all following fields
+    std::mutex m_mutex;
+
+    //! signals new blocks or free space
+    std::condition_variable m_cv;
+
+    //! decompressed blocks, an empty block marks the end
+    std::deque<std::string> m_blocks;
+
+    //! read position in front block
+    size_t m_pos;
+
+    //! reader closed the stream
+    bool m_stop;
+
+    //! error of the decompressor
+    std::exception_ptr m_error;
+
+    //! background thread
+    std::thread m_thread;
+
+    //! background thread main loop
+    void worker()
+    {
+        std::vector<char> buffer(block_size);
+
+        while (true)
+        {
+            size_t rb;
+            try {
+                rb = m_in->read(buffer.data(), buffer.size());
+            }
+            catch (...) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_error = std::current_exception();
+                m_cv.notify_all();
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            while (m_blocks.size() >= max_blocks && !m_stop)
+                m_cv.wait(lock);
+
+            if (m_stop) return;
+
+            m_blocks.push_back(std::string(buffer.data(), rb));
+            m_cv.notify_all();
+
+            if (rb == 0) return;
+        }
+    }
+
+public:
+    //! Start the background thread.
+    ReadAheadDecompress(const Decompress& in)
+        : DecompressImpl(in->fname()),
+          m_in(in), m_pos(0), m_stop(false)
+    {
+        m_thread = std::thread(&ReadAheadDecompress::worker, this);
+    }
+
+    //! Stop and join the background thread.
+    ~ReadAheadDecompress()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_cv.notify_all();
+        }
+        m_thread.join();
+    }
+
+    //! Copy decompressed data from the queue, rethrows errors of the
+    //! decompressor.
+    size_t read(char* data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (m_blocks.empty() && !m_error)
+            m_cv.wait(lock);
+
+        if (m_blocks.empty()) std::rethrow_exception(m_error);
+
+        std::string& block = m_blocks.front();
+        if (block.empty()) return 0;
+
+        size_t rb = std::min(size, block.size() - m_pos);
+        memcpy(data, block.data() + m_pos, rb);
+        m_pos += rb;
+
+        if (m_pos == block.size()) {
+            m_blocks.pop_front();
+            m_pos = 0;
+            m_cv.notify_all();
+        }
+
+        return rb;
+    }
+};
+
+//! Start a thread which decompresses the stream ahead of the reader.
+Decompress DecompressImpl::read_ahead(const Decompress& in)
+{
+    return Decompress(new ReadAheadDecompress(in));
+}
@@ -0,0 +1,70 @@
+/******************************************************************************
+ * src/decompress.h
+ *
+ * In-process streaming decompression of gzip, bzip2 and xz files, and a
+ * background thread reading ahead of the consumer.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef DECOMPRESS_HEADER
+#define DECOMPRESS_HEADER
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+class DecompressImpl;
+
+//! shared pointer to a decompressing input stream
+typedef boost::shared_ptr<DecompressImpl> Decompress;
+
+//! Abstract input stream delivering decompressed data of a file.
+class DecompressImpl
+{
+protected:
+    //! name of the compressed file
+    std::string m_fname;
+
+public:
+    //! Save file name.
+    DecompressImpl(const std::string& fname);
+
+    //! Close the file.
+    virtual ~DecompressImpl();
+
+    //! Return name of the compressed file.
+    const std::string& fname() const;
+
+    //! Read up to size decompressed bytes into data, returns zero at the end
+    //! of the stream, throws on errors.
+    virtual size_t read(char* data, size_t size) = 0;
+
+    //! Return true if the file name has an extension which is decompressed
+    //! in-process.
+    static bool is_compressed(const std::string& fname);
+
+    //! Open a compressed file for decompression, determining the format from
+    //! the file extension. Returns an empty pointer with errno set if the file
+    //! cannot be opened, or with errno zero if the format is not supported.
+    static Decompress open(const std::string& fname);
+
+    //! Start a thread which decompresses the stream ahead of the reader.
+    static Decompress read_ahead(const Decompress& in);
+};
+
+#endif // DECOMPRESS_HEADER
@@ -22,19 +22,20 @@
 
 #include "fieldset.h"
 #include "common.h"
+#include "strtools.h"
 
 #include <cassert>
 #include <sstream>
 
-//! return the SQL data type name for a field type
-const char* FieldSet::sqlname(fieldtype t)
+//! return the SQL data type name for a field type in the given database
+const char* FieldSet::sqlname(fieldtype t, SqlDatabase::db_type dbtype)
 {
     switch (t) {
     default:
     case T_NONE: return "NONE";
     case T_VARCHAR:
     {
-        if (g_db->type() == SqlDatabase::DB_MYSQL)
+        if (dbtype == SqlDatabase::DB_MYSQL)
             return "TEXT";
 
         return "VARCHAR";
@@ -44,10 +45,34 @@ const char* FieldSet::sqlname(fieldtype t)
     }
 }
 
+//! return the field type of an SQL column type name, following SQLite's
+//! rules for column affinity.
+FieldSet::fieldtype FieldSet::from_sqlname(const std::string& sqltype)
+{
+    std::string t = str_tolower(sqltype);
+
+    if (t.find("int") != std::string::npos)
+        return T_INTEGER;
+
+    if (t.find("char") != std::string::npos ||
+        t.find("text") != std::string::npos ||
+        t.find("clob") != std::string::npos)
+        return T_VARCHAR;
+
+    if (t.find("real") != std::string::npos ||
+        t.find("floa") != std::string::npos ||
+        t.find("doub") != std::string::npos ||
+        t.find("numeric") != std::string::npos ||
+        t.find("decimal") != std::string::npos)
+        return T_DOUBLE;
+
+    return T_VARCHAR;
+}
+
 //! detect the field type of a string
-FieldSet::fieldtype FieldSet::detect(const std::string& str)
+FieldSet::fieldtype FieldSet::detect(const StringRef& str)
 {
-    std::string::const_iterator it = str.begin();
+    StringRef::const_iterator it = str.begin();
 
     // skip sign
     if (it != str.end() && (*it == '+' || *it == '-')) ++it;
@@ -116,40 +141,72 @@ void FieldSet::check_detect()
     assert( detect("sdfdf") == T_VARCHAR );
 }
 
+//! return index of field with given key, or -1 if it does not exist.
+int FieldSet::find(const std::string& key) const
+{
+    return find(KeyTable::intern(key));
+}
+
 //! add new field (key,value), detect the value type and augment found type
 void FieldSet::add_field(const std::string& key, const std::string& value)
 {
-    fieldtype t = detect(value);
+    add_field(KeyTable::intern(key), detect(value));
+}
+
+//! add new field with already detected type and augment found type
+void FieldSet::add_field(const std::string& key, fieldtype t)
+{
+    add_field(KeyTable::intern(key), t);
+}
+
+//! add new field by key id with already detected type and augment found type
+void FieldSet::add_field(KeyTable::id_type id, fieldtype t)
+{
+    int col = find(id);
 
-    for (fieldset_type::iterator fi = m_fieldset.begin();
-         fi != m_fieldset.end(); ++fi)
+    if (col >= 0) // found matching entry
     {
-        if (fi->first == key) // found matching entry
-        {
-            if (fi->second > t) {
-                fi->second = t;
-            }
-            return;
+        if (m_fieldset[col].second > t) {
+            m_fieldset[col].second = t;
         }
+        return;
     }
 
     // add new entry
-    m_fieldset.push_back( sfpair_type(key,t) );
+    if (id >= m_index.size())
+        m_index.resize(id + 1, -1);
+
+    m_index[id] = m_fieldset.size();
+    m_ids.push_back(id);
+    m_fieldset.push_back( sfpair_type(KeyTable::name(id), t) );
+}
+
+//! return quoted name and SQL type of field i for a column definition, or
+//! only the name if untyped.
+std::string FieldSet::make_column(const SqlDatabase& db, size_t i,
+                                  bool typed) const
+{
+    if (!typed)
+        return db.quote_field(m_fieldset[i].first);
+
+    return db.quote_field(m_fieldset[i].first) + ' ' +
+           sqlname(m_fieldset[i].second, db.type());
 }
 
 //! return CREATE TABLE for the given fieldset
-std::string FieldSet::make_create_table(const std::string& tablename, bool temporary) const
+std::string FieldSet::make_create_table(const SqlDatabase& db,
+                                        const std::string& tablename,
+                                        bool temporary, bool typed) const
 {
     std::ostringstream os;
     os << "CREATE "
        << (temporary ? "TEMPORARY " : "")
-       << "TABLE " << g_db->quote_field(tablename) << " (";
+       << "TABLE " << db.quote_field(tablename) << " (";
 
-    for (fieldset_type::const_iterator fi = m_fieldset.begin();
-         fi != m_fieldset.end(); ++fi)
+    for (size_t i = 0; i < m_fieldset.size(); ++i)
     {
-        if (fi != m_fieldset.begin()) os << ", ";
-        os << g_db->quote_field(fi->first) << ' ' << sqlname(fi->second);
+        if (i != 0) os << ", ";
+        os << make_column(db, i, typed);
     }
 
     os << ")";
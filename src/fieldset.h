@@ -27,6 +27,10 @@
 #include <vector>
 #include <utility>
 
+#include "keytable.h"
+#include "sql.h"
+#include "stringref.h"
+
 //! List of field specifications to automatically detect SQL columns types
 class FieldSet
 {
@@ -35,11 +39,14 @@ public:
     //! specific, lower ones are more generic.
     enum fieldtype { T_NONE, T_VARCHAR, T_DOUBLE, T_INTEGER };
 
-    //! return the SQL data type name for a field type
-    static const char* sqlname(fieldtype t);
+    //! return the SQL data type name for a field type in the given database
+    static const char* sqlname(fieldtype t, SqlDatabase::db_type dbtype);
+
+    //! return the field type of an SQL column type name
+    static fieldtype from_sqlname(const std::string& sqltype);
 
     //! detect the field type of a string
-    static fieldtype detect(const std::string& str);
+    static fieldtype detect(const StringRef& str);
 
     //! self-verify field type detection
     static void check_detect();
@@ -54,6 +61,12 @@ protected:
     //! list of field specifications
     fieldset_type m_fieldset;
 
+    //! key id of each field
+    std::vector<KeyTable::id_type> m_ids;
+
+    //! index of field by key id, or -1 if the key is not a field
+    std::vector<int> m_index;
+
 public:
     //! number of fields is set
     inline size_t count() const
@@ -61,11 +74,52 @@ public:
         return m_fieldset.size();
     }
 
+    //! return key name of field i
+    inline const std::string& key(size_t i) const
+    {
+        return m_fieldset[i].first;
+    }
+
+    //! return detected type of field i
+    inline fieldtype type(size_t i) const
+    {
+        return m_fieldset[i].second;
+    }
+
+    //! return key id of field i
+    inline KeyTable::id_type id(size_t i) const
+    {
+        return m_ids[i];
+    }
+
+    //! return index of field with given key id, or -1 if it does not exist.
+    inline int find(KeyTable::id_type id) const
+    {
+        return id < m_index.size() ? m_index[id] : -1;
+    }
+
+    //! return index of field with given key, or -1 if it does not exist.
+    int find(const std::string& key) const;
+
     //! add new field (key,value), detect the value type and augment found type
     void add_field(const std::string& key, const std::string& value);
 
+    //! add new field with already detected type and augment found type
+    void add_field(const std::string& key, fieldtype t);
+
+    //! add new field by key id with already detected type and augment found
+    //! type
+    void add_field(KeyTable::id_type id, fieldtype t);
+
+    //! return quoted name and SQL type of field i for a column definition,
+    //! or only the name if untyped.
+    std::string make_column(const SqlDatabase& db, size_t i,
+                            bool typed = true) const;
+
     //! return CREATE TABLE for the given fieldset
-    std::string make_create_table(const std::string& tablename, bool temporary) const;
+    std::string make_create_table(const SqlDatabase& db,
+                                  const std::string& tablename,
+                                  bool temporary, bool typed = true) const;
 };
 
 #endif // FIELDSET_HEADER
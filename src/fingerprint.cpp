@@ -0,0 +1,189 @@
+/******************************************************************************
+ * src/fingerprint.cpp
+ *
+ * 128-bit fingerprints of lines and an open-addressing hash set of them, used
+ * to detect duplicate lines without storing the lines themselves.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "fingerprint.h"
+#include "common.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+//! magic header of fingerprint files, including format version
+static const char fingerprint_magic[16] = "sqlplot-fprint1";
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdLLU;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53LLU;
+    k ^= k >> 33;
+    return k;
+}
+
+//! calculate fingerprint of data using MurmurHash3_x64_128
+Fingerprint Fingerprint::hash(const void* key, size_t len)
+{
+    const uint8_t* data = (const uint8_t*)key;
+    const size_t nblocks = len / 16;
+
+    uint64_t h1 = 0, h2 = 0;
+
+    const uint64_t c1 = 0x87c37b91114253d5LLU;
+    const uint64_t c2 = 0x4cf5ad432745937fLLU;
+
+    // body
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        uint64_t k1, k2;
+        memcpy(&k1, data + i * 16, 8);
+        memcpy(&k2, data + i * 16 + 8, 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    // tail
+    const uint8_t* tail = data + nblocks * 16;
+
+    uint64_t k1 = 0, k2 = 0;
+
+    switch (len & 15)
+    {
+    case 15: k2 ^= ((uint64_t)tail[14]) << 48; // fall through
+    case 14: k2 ^= ((uint64_t)tail[13]) << 40; // fall through
+    case 13: k2 ^= ((uint64_t)tail[12]) << 32; // fall through
+    case 12: k2 ^= ((uint64_t)tail[11]) << 24; // fall through
+    case 11: k2 ^= ((uint64_t)tail[10]) << 16; // fall through
+    case 10: k2 ^= ((uint64_t)tail[9]) << 8;   // fall through
+    case 9:  k2 ^= ((uint64_t)tail[8]) << 0;
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        // fall through
+
+    case 8: k1 ^= ((uint64_t)tail[7]) << 56; // fall through
+    case 7: k1 ^= ((uint64_t)tail[6]) << 48; // fall through
+    case 6: k1 ^= ((uint64_t)tail[5]) << 40; // fall through
+    case 5: k1 ^= ((uint64_t)tail[4]) << 32; // fall through
+    case 4: k1 ^= ((uint64_t)tail[3]) << 24; // fall through
+    case 3: k1 ^= ((uint64_t)tail[2]) << 16; // fall through
+    case 2: k1 ^= ((uint64_t)tail[1]) << 8;  // fall through
+    case 1: k1 ^= ((uint64_t)tail[0]) << 0;
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    // finalization
+    h1 ^= len; h2 ^= len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    Fingerprint fp = { h1, h2 };
+    return fp;
+}
+
+//! insert fingerprints from a file, returns the number read, or zero if the
+//! file does not exist.
+size_t FingerprintSet::load(const std::string& path)
+{
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) {
+        if (errno == ENOENT) return 0;
+        OUT_THROW("Error reading fingerprint file " << path << ": " << strerror(errno));
+    }
+
+    char magic[sizeof(fingerprint_magic)];
+    if (fread(magic, sizeof(magic), 1, in) != 1 ||
+        memcmp(magic, fingerprint_magic, sizeof(magic)) != 0)
+    {
+        fclose(in);
+        OUT_THROW("Error reading fingerprint file " << path << ": invalid format");
+    }
+
+    size_t count = 0;
+    Fingerprint buffer[4096];
+    size_t rb;
+
+    while ((rb = fread(buffer, sizeof(Fingerprint), 4096, in)) != 0)
+    {
+        for (size_t i = 0; i < rb; ++i)
+            insert(buffer[i]);
+        count += rb;
+    }
+
+    bool error = ferror(in);
+    fclose(in);
+
+    if (error)
+        OUT_THROW("Error reading fingerprint file " << path << ": " << strerror(errno));
+
+    return count;
+}
+
+//! append fingerprints to a file, which is created if it does not exist.
+void FingerprintSet::append(const std::string& path,
+                            const std::vector<Fingerprint>& list)
+{
+    FILE* out = fopen(path.c_str(), "ab");
+    if (!out)
+        OUT_THROW("Error writing fingerprint file " << path << ": " << strerror(errno));
+
+    bool ok = (fseek(out, 0, SEEK_END) == 0);
+
+    // new file: write header first
+    if (ok && ftell(out) == 0)
+        ok = fwrite(fingerprint_magic, sizeof(fingerprint_magic), 1, out) == 1;
+
+    if (ok && !list.empty())
+        ok = fwrite(list.data(), sizeof(Fingerprint), list.size(), out) == list.size();
+
+    if (fclose(out) != 0) ok = false;
+
+    if (!ok)
+        OUT_THROW("Error writing fingerprint file " << path << ": " << strerror(errno));
+}
+
+//! remove a fingerprint file, if it exists.
+void FingerprintSet::remove(const std::string& path)
+{
+    if (unlink(path.c_str()) != 0 && errno != ENOENT)
+        OUT_THROW("Error removing fingerprint file " << path << ": " << strerror(errno));
+}
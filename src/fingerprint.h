@@ -0,0 +1,153 @@
+/******************************************************************************
+ * src/fingerprint.h
+ *
+ * 128-bit fingerprints of lines and an open-addressing hash set of them, used
+ * to detect duplicate lines without storing the lines themselves.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef FINGERPRINT_HEADER
+#define FINGERPRINT_HEADER
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+//! 128-bit fingerprint of a string
+struct Fingerprint
+{
+    uint64_t lo, hi;
+
+    //! compare fingerprints
+    bool operator == (const Fingerprint& b) const
+    {
+        return lo == b.lo && hi == b.hi;
+    }
+
+    //! calculate fingerprint of data using MurmurHash3_x64_128, which was
+    //! written by Austin Appleby and placed in the public domain.
+    static Fingerprint hash(const void* key, size_t len);
+
+    //! calculate fingerprint of a string
+    static Fingerprint hash(const std::string& str)
+    {
+        return hash(str.data(), str.size());
+    }
+};
+
+/*!
+ * Hash set of fingerprints using open addressing with linear probing in a
+ * flat table. The all-zero fingerprint marks empty slots, hence it is mapped
+ * to another value when inserted.
+ */
+class FingerprintSet
+{
+protected:
+    //! flat table, size is a power of two
+    std::vector<Fingerprint> m_table;
+
+    //! number of fingerprints stored
+    size_t m_size;
+
+    //! replace the reserved empty fingerprint
+    static Fingerprint fix_empty(Fingerprint fp)
+    {
+        if (fp.lo == 0 && fp.hi == 0) fp.lo = 1;
+        return fp;
+    }
+
+    //! insert into table without growing, returns true if fp is new.
+    bool insert_slot(const Fingerprint& fp)
+    {
+        size_t mask = m_table.size() - 1;
+
+        for (size_t i = fp.lo & mask; ; i = (i + 1) & mask)
+        {
+            Fingerprint& slot = m_table[i];
+
+            if (slot.lo == 0 && slot.hi == 0) {
+                slot = fp;
+                return true;
+            }
+            if (slot == fp)
+                return false;
+        }
+    }
+
+    //! double size of table and reinsert all fingerprints
+    void grow()
+    {
+        std::vector<Fingerprint> old(std::max<size_t>(1024, 2 * m_table.size()));
+        old.swap(m_table);
+
+        for (size_t i = 0; i < old.size(); ++i)
+        {
+            if (old[i].lo != 0 || old[i].hi != 0)
+                insert_slot(old[i]);
+        }
+    }
+
+public:
+    //! construct empty set
+    FingerprintSet()
+        : m_size(0)
+    {
+    }
+
+    //! number of fingerprints stored
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    //! insert fingerprint, returns true if it was not contained before.
+    bool insert(const Fingerprint& fp)
+    {
+        // keep load factor below one half
+        if (2 * (m_size + 1) > m_table.size()) grow();
+
+        if (!insert_slot(fix_empty(fp))) return false;
+
+        ++m_size;
+        return true;
+    }
+
+    //! remove all fingerprints
+    void clear()
+    {
+        m_table.clear();
+        m_size = 0;
+    }
+
+    //! insert fingerprints from a file, returns the number read, or zero if
+    //! the file does not exist. Throws on errors.
+    size_t load(const std::string& path);
+
+    //! append fingerprints to a file, which is created if it does not exist.
+    //! Throws on errors.
+    static void append(const std::string& path,
+                       const std::vector<Fingerprint>& list);
+
+    //! remove a fingerprint file, if it exists. Throws on errors.
+    static void remove(const std::string& path);
+};
+
+#endif // FINGERPRINT_HEADER
@@ -249,7 +249,7 @@ void SpGnuplot::plot(size_t ln, size_t indent, const std::string& cmdline)
         for (unsigned int col = 0; col < sql->num_cols(); ++col)
         {
             if (col != 0) df << '\t';
-            df << sql->text(col);
+            df << sql->view(col);
         }
         df << std::endl;
     }
@@ -332,16 +332,16 @@ void SpGnuplot::multiplot(size_t ln, size_t indent, const std::string& cmdline)
 
     // collect coordinates groups
     {
-        std::vector<std::string> lastgroup;
+        std::vector<std::string> lastgroup, rowgroup(groupcols.size());
         size_t rows = 0;
 
         while (sql->step())
         {
             // collect groupfields for this row
-            std::vector<std::string> rowgroup (groupcols.size());
-
-            for (size_t i = 0; i < groupcols.size(); ++i)
-                rowgroup[i] = sql->text(groupcols[i]);
+            for (size_t i = 0; i < groupcols.size(); ++i) {
+                StringRef group = sql->view(groupcols[i]);
+                rowgroup[i].assign(group.data(), group.size());
+            }
 
             if (sql->current_row() == 0 || lastgroup != rowgroup)
             {
@@ -375,16 +375,16 @@ void SpGnuplot::multiplot(size_t ln, size_t indent, const std::string& cmdline)
             }
 
             // group fields match with last row -> append coordinates.
-            df << sql->text(col_x)
-               << '\t' << sql->text(col_y);
+            df << sql->view(col_x)
+               << '\t' << sql->view(col_y);
 
             if (have_xerrorbars) {
-                df << '\t' << sql->text(col_xmin)
-                   << '\t' << sql->text(col_xmax);
+                df << '\t' << sql->view(col_xmin)
+                   << '\t' << sql->view(col_xmax);
             }
             if (have_yerrorbars) {
-                df << '\t' << sql->text(col_ymin)
-                   << '\t' << sql->text(col_ymax);
+                df << '\t' << sql->view(col_ymin)
+                   << '\t' << sql->view(col_ymax);
             }
 
             df << std::endl;
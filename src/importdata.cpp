@@ -22,457 +22,2174 @@
  *****************************************************************************/
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
-
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <functional>
+#include <utility>
 #include <vector>
+#include <deque>
+#include <exception>
 #include <set>
+#include <thread>
 
 #include "simpleopt.h"
 #include "simpleglob.h"
 #include "importdata.h"
+#include "importtimer.h"
+#include "binresult.h"
+#include "decompress.h"
+#include "linescan.h"
+#include "mappedfile.h"
+#include "pipeline.h"
+#include "spillfile.h"
+#include "sqlite.h"
 #include "common.h"
+#include "strtools.h"
 
 //! check for RESULT line, returns offset of key=values
 static inline size_t
-is_result_line(const std::string& line)
-{
-    if (line.substr(0,6) == "RESULT" && isblank(line[6]))
-        return 7;
-
-    if (line.substr(0,9) == "// RESULT" && isblank(line[9]))
-        return 10;
-
-    if (line.substr(0,8) == "# RESULT" && isblank(line[8]))
-        return 9;
-
-    return 0;
-}
-
-//! split a string into "key=value" parts at TABs or spaces.
-static inline std::vector<std::string>
-split_result_line(const std::string& str)
+is_result_line(const StringRef& line)
 {
-    std::vector<std::string> out;
+    // reject most lines by their first character
+    if (line.empty()) return 0;
 
-    // auto-select separation character
-    char sep = (str.find('\t') != std::string::npos) ? '\t' : ' ';
-
-    std::string::const_iterator it = str.begin();
-    it += is_result_line(str);
-
-    std::string::const_iterator last = it;
-
-    for (; it != str.end(); ++it)
+    switch (line[0])
     {
-        if (*it == sep)
-        {
-            if (last != it)
-                out.push_back(std::string(last, it));
-            last = it + 1;
-        }
+    case 'R':
+        if (line.size() > 6 && line.starts_with("RESULT") && isblank(line[6]))
+            return 7;
+        break;
+
+    case '/':
+        if (line.size() > 9 && line.starts_with("// RESULT") && isblank(line[9]))
+            return 10;
+        break;
+
+    case '#':
+        if (line.size() > 8 && line.starts_with("# RESULT") && isblank(line[8]))
+            return 9;
+        break;
     }
 
-    if (last != it)
-        out.push_back(std::string(last, it));
-
-    return out;
+    return 0;
 }
 
-//! split a "key=value" string into key and value parts
+//! split a "key=value" field into key and value parts, both reference the
+//! line, unless a key col# is generated into keybuf.
 static inline void
-split_keyvalue(const std::string& field, size_t col,
-               std::string& key, std::string& value,
-               bool opt_colnums = false)
+split_keyvalue(const StringRef& line, const LineScanner::Field& field,
+               size_t col, StringRef& key, StringRef& value,
+               std::string& keybuf, bool opt_colnums = false)
 {
-    std::string::size_type eqpos = field.find('=');
-    if (eqpos == std::string::npos)
+    if (field.eq == LineScanner::npos)
     {
+        StringRef str = line.substr(field.begin, field.end - field.begin);
+
         if (opt_colnums) {
             // add field as col#
             std::ostringstream os;
             os << "col" << col;
-            key = os.str();
-            value = field;
+            keybuf = os.str();
+            key = keybuf;
+            value = str;
         }
         else {
             // else use field as boolean key
-            key = field;
+            key = str;
             value = "1";
         }
     }
     else {
-        key = field.substr(0, eqpos);
-        value = field.substr(eqpos+1);
+        key = line.substr(field.begin, field.eq - field.begin);
+        value = line.substr(field.eq + 1, field.end - field.eq - 1);
     }
 }
 
-//! deduplicate key names by appending numbers
-static inline std::string
-dedup_key(const std::string& key, std::set<std::string>& keyset)
+//! deduplicate key names by appending numbers, seen flags the key ids
+//! already used in the line.
+static inline KeyTable::id_type
+dedup_key(const StringRef& key, std::vector<bool>& seen)
 {
-    // unique key
-    if (keyset.find(key) == keyset.end())
-    {
-        keyset.insert(key);
-        return key;
-    }
+    KeyTable::id_type id = KeyTable::intern(key);
 
     // append numbers to make unique
-    for (size_t num = 1; ; ++num)
+    for (size_t num = 1; id < seen.size() && seen[id]; ++num)
     {
         std::ostringstream nkey;
         nkey << key << num;
 
-        if (keyset.find(nkey.str()) == keyset.end())
-        {
-            keyset.insert(nkey.str());
-            return nkey.str();
-        }
+        id = KeyTable::intern(nkey.str());
     }
 
-    abort();
+    if (id >= seen.size()) seen.resize(id + 1);
+    seen[id] = true;
+
+    return id;
 }
 
 //! CREATE TABLE for the accumulated data set
-bool ImportData::create_table() const
+bool ImportData::create_table()
 {
-    if (g_db->exist_table(m_tablename))
+    if (m_db->exist_table(m_tablename))
     {
-        if (mopt_append_data)
+        // incremental imports always continue the existing table, which is
+        // only changed to fit the data when processing a stream.
+        if (mopt_append_data || mopt_incremental)
         {
             OUT("Table \"" << m_tablename << "\" exists. Appending data.");
+            if (mopt_single_pass) adopt_table();
             return true;
         }
         OUT("Table \"" << m_tablename << "\" exists. Replacing data.");
 
         std::ostringstream cmd;
-        cmd << "DROP TABLE " << g_db->quote_field(m_tablename);
+        cmd << "DROP TABLE " << m_db->quote_field(m_tablename);
 
-        g_db->execute(cmd.str());
+        m_db->execute(cmd.str());
     }
 
-    std::string createtable = m_fieldset.make_create_table(m_tablename, mopt_temporary_table);
+    std::string createtable =
+        m_fieldset.make_create_table(*m_db, m_tablename, mopt_temporary_table,
+                                     !mopt_untyped);
 
     if (mopt_verbose >= 1)
         OUT(createtable);
 
     try
     {
-        g_db->execute(createtable);
+        m_db->execute(createtable);
     }
     catch (std::runtime_error &e)
     {
-        if (g_db->type() == SqlDatabase::DB_MYSQL)
+        if (m_db->type() == SqlDatabase::DB_MYSQL)
         {
             // in MySQL there is no way to check for existing TEMPORARY TABLES,
             // so we just DROP TABLE and retry CREATE TABLE if it fails onces.
 
-            OUT("Table \"" << m_tablename << "\" maybe exists. Replacing data.");
+            OUT("Table \"" << m_tablename << "\" maybe exists. Replacing data.");
+
+            std::ostringstream cmd;
+            cmd << "DROP TABLE " << m_db->quote_field(m_tablename);
+
+            m_db->execute(cmd.str());
+
+            m_db->execute(createtable);
+        }
+        else {
+            throw; // other databases have real errors.
+        }
+    }
+
+    return true;
+}
+
+//! ALTER TABLE to add the new field col of the field set
+void ImportData::add_column(size_t col)
+{
+    std::ostringstream cmd;
+    cmd << "ALTER TABLE " << m_db->quote_field(m_tablename)
+        << " ADD COLUMN " << m_fieldset.make_column(*m_db, col, !mopt_untyped);
+
+    if (mopt_verbose >= 1) OUT(cmd.str());
+
+    m_db->execute(cmd.str());
+}
+
+//! change column col to the wider type of the field set
+void ImportData::widen_column(size_t col)
+{
+    const std::string& key = m_fieldset.key(col);
+    const char* sqltype = FieldSet::sqlname(m_fieldset.type(col), m_db->type());
+
+    std::ostringstream cmd;
+
+    if (m_db->type() == SqlDatabase::DB_PGSQL)
+    {
+        cmd << "ALTER TABLE " << m_db->quote_field(m_tablename)
+            << " ALTER COLUMN " << m_db->quote_field(key)
+            << " TYPE " << sqltype
+            << " USING " << m_db->quote_field(key) << "::" << sqltype;
+    }
+    else if (m_db->type() == SqlDatabase::DB_MYSQL)
+    {
+        cmd << "ALTER TABLE " << m_db->quote_field(m_tablename)
+            << " MODIFY COLUMN " << m_fieldset.make_column(*m_db, col);
+    }
+    else
+    {
+        // SQLite cannot change column types: copy rows into a new table, which
+        // would lose indexes and triggers, hence refuse to rebuild those.
+        std::vector<std::string> params(1, m_tablename);
+
+        // count indexes and triggers, and whether the table is TEMPORARY to
+        // keep it in the schema it was created in.
+        SqlQuery sql = m_db->query(
+            "SELECT "
+            "(SELECT COUNT(*) FROM sqlite_master WHERE tbl_name = $1 "
+            "AND type IN ('index', 'trigger')) + "
+            "(SELECT COUNT(*) FROM sqlite_temp_master WHERE tbl_name = $1 "
+            "AND type IN ('index', 'trigger')), "
+            "(SELECT COUNT(*) FROM sqlite_temp_master WHERE tbl_name = $1 "
+            "AND type = 'table')", params);
+
+        if (!sql->step())
+            OUT_THROW("widen_column() failed.");
+
+        if (sql->text(0) != "0")
+        {
+            OUT_THROW("Cannot widen column \"" << key << "\" of table \"" <<
+                      m_tablename << "\", which has indexes or triggers.");
+        }
+
+        bool temporary = (sql->text(1) != "0");
+        sql.reset();
+
+        std::string oldtable = m_tablename + "_sqlplot_widen";
+
+        std::ostringstream rename;
+        rename << "ALTER TABLE " << m_db->quote_field(m_tablename)
+               << " RENAME TO " << m_db->quote_field(oldtable);
+
+        if (mopt_verbose >= 1) OUT(rename.str());
+        m_db->execute(rename.str());
+
+        std::string createtable =
+            m_fieldset.make_create_table(*m_db, m_tablename, temporary);
+
+        if (mopt_verbose >= 1) OUT(createtable);
+        m_db->execute(createtable);
+
+        cmd << "INSERT INTO " << m_db->quote_field(m_tablename)
+            << " SELECT ";
+        for (size_t i = 0; i < m_fieldset.count(); ++i)
+        {
+            if (i != 0) cmd << ',';
+            if (i == col)
+                cmd << "CAST(" << m_db->quote_field(key) << " AS " << sqltype << ")";
+            else
+                cmd << m_db->quote_field(m_fieldset.key(i));
+        }
+        cmd << " FROM " << m_db->quote_field(oldtable);
+
+        if (mopt_verbose >= 1) OUT(cmd.str());
+        m_db->execute(cmd.str());
+
+        cmd.str("");
+        cmd << "DROP TABLE " << m_db->quote_field(oldtable);
+    }
+
+    if (mopt_verbose >= 1) OUT(cmd.str());
+
+    m_db->execute(cmd.str());
+}
+
+//! add or widen the column of a field, returns true if the table changed
+bool ImportData::widen_field(KeyTable::id_type id, FieldSet::fieldtype type)
+{
+    int col = m_fieldset.find(id);
+
+    if (col < 0)
+    {
+        m_fieldset.add_field(id, type);
+        add_column(m_fieldset.count() - 1);
+        return true;
+    }
+    else if (type < m_fieldset.type(col))
+    {
+        m_fieldset.add_field(id, type);
+        if (mopt_untyped) return false;
+
+        widen_column(col);
+        return true;
+    }
+
+    return false;
+}
+
+//! add or widen columns of the table for the fields of a parsed line
+void ImportData::widen_schema(const ParsedLine& pl)
+{
+    bool changed = false;
+
+    for (size_t i = 0; i < pl.keys.size(); ++i)
+        changed |= widen_field(pl.keys[i], pl.types[i]);
+
+    // prepared statements may refer to the old table
+    if (changed) m_insert_cache.clear();
+}
+
+//! load the columns of the existing table into the field set, then add or
+//! widen columns for the fields found in the data so far.
+void ImportData::adopt_table()
+{
+    FieldSet found;
+    std::swap(found, m_fieldset);
+
+    SqlDatabase::columns_type cols = m_db->table_columns(m_tablename);
+
+    for (size_t i = 0; i < cols.size(); ++i)
+        m_fieldset.add_field(cols[i].first, FieldSet::from_sqlname(cols[i].second));
+
+    for (size_t i = 0; i < found.count(); ++i)
+        widen_field(found.id(i), found.type(i));
+
+    m_insert_cache.clear();
+}
+
+//! return (cached) prepared INSERT statement for the given columns, binding
+//! native values of decoded binary rows as given by ptypes.
+SqlStatement& ImportData::insert_statement(
+    const klist_type& keys, const SqlStatementImpl::ptypes_type& ptypes)
+{
+    // signature of column layout are the bytes of the key ids and parameter
+    // types of binary rows
+    std::string signature(reinterpret_cast<const char*>(keys.data()),
+                          keys.size() * sizeof(keys[0]));
+    signature.append(reinterpret_cast<const char*>(ptypes.data()),
+                     ptypes.size() * sizeof(ptypes[0]));
+
+    SqlStatement* stmt = m_insert_cache.find(signature);
+    if (stmt) return *stmt;
+
+    // construct INSERT command for new column layout
+    std::ostringstream cmd;
+    cmd << "INSERT INTO " << m_db->quote_field(m_tablename) << " (";
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (i != 0) cmd << ',';
+        cmd << m_db->quote_field(KeyTable::name(keys[i]));
+    }
+
+    cmd << ") VALUES (";
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (i != 0) cmd << ',';
+        cmd << m_db->placeholder(i);
+    }
+    cmd << ')';
+
+    // bind numbers natively in numeric columns
+    SqlStatementImpl::ptypes_type types(keys.size(), SqlStatementImpl::PARAM_TEXT);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (i < ptypes.size() && ptypes[i] != SqlStatementImpl::PARAM_TEXT) {
+            types[i] = ptypes[i];
+            continue;
+        }
+
+        int col = m_fieldset.find(keys[i]);
+        if (col < 0 || mopt_untyped) continue;
+
+        if (m_fieldset.type(col) == FieldSet::T_INTEGER)
+            types[i] = SqlStatementImpl::PARAM_INTEGER;
+        else if (m_fieldset.type(col) == FieldSet::T_DOUBLE)
+            types[i] = SqlStatementImpl::PARAM_DOUBLE;
+    }
+
+    if (mopt_verbose >= 2) OUT(cmd.str());
+
+    return m_insert_cache.insert(signature, m_db->prepare(cmd.str(), types));
+}
+
+//! split a RESULT line into deduplicated keys and their values, which
+//! reference the line.
+static inline void
+split_line_keyvalues(const StringRef& line,
+                     std::vector<KeyTable::id_type>& keys,
+                     std::vector<StringRef>& values)
+{
+    // one scanner and set of used keys per parser thread, to reuse buffers
+    static thread_local LineScanner scanner;
+    static thread_local std::vector<bool> seen;
+
+    const std::vector<LineScanner::Field>& fields =
+        scanner.scan(line.data(), line.size(), is_result_line(line));
+
+    keys.resize(fields.size());
+    values.resize(fields.size());
+
+    StringRef key;
+    std::string keybuf;
+
+    for (size_t i = 0; i < fields.size(); ++i)
+    {
+        split_keyvalue(line, fields[i], i, key, values[i], keybuf);
+
+        keys[i] = dedup_key(key, seen);
+    }
+
+    // clear only the flags set by this line
+    for (size_t i = 0; i < keys.size(); ++i)
+        seen[keys[i]] = false;
+}
+
+//! split a RESULT line or decoded binary row into keys, values and the
+//! parameter types of native values.
+static inline void
+split_line(const StringRef& line, std::vector<KeyTable::id_type>& keys,
+           std::vector<StringRef>& values,
+           SqlStatementImpl::ptypes_type& ptypes)
+{
+    if (BinResultDecoder::is_row(line)) {
+        BinResultDecoder::split_row(line, keys, values, ptypes);
+    }
+    else {
+        split_line_keyvalues(line, keys, values);
+        ptypes.clear();
+    }
+}
+
+//! return printable form of a RESULT line or decoded binary row
+static inline std::string printable_line(const StringRef& line)
+{
+    if (BinResultDecoder::is_row(line))
+        return BinResultDecoder::format_row(line);
+    return line.str();
+}
+
+//! check for and remember duplicate lines if requested
+bool ImportData::is_duplicate(const StringRef& line)
+{
+    if (!mopt_noduplicates) return false;
+
+    // binary rows contain key ids of this process, hash their text form
+    Fingerprint fp;
+    if (BinResultDecoder::is_row(line)) {
+        std::string text = BinResultDecoder::format_row(line);
+        fp = Fingerprint::hash(text.data(), text.size());
+    }
+    else {
+        fp = Fingerprint::hash(line.data(), line.size());
+    }
+
+    if (!m_fingerprints.insert(fp))
+    {
+        if (mopt_verbose >= 1)
+            OUT("Dropping duplicate " << printable_line(line));
+        return true;
+    }
+
+    if (!mopt_fingerprint_file.empty())
+        m_new_fingerprints.push_back(fp);
+
+    return false;
+}
+
+//! insert a line with given keys and values into the database table
+bool ImportData::insert_line(const StringRef& line,
+                             const klist_type& keys, const vlist_type& values,
+                             const SqlStatementImpl::ptypes_type& ptypes)
+{
+    // check for duplicate lines
+    if (is_duplicate(line)) return true;
+
+    ImportTimer::Scope timer(ImportTimer::INSERT);
+
+    insert_statement(keys, ptypes)->execute(values);
+
+    return true;
+}
+
+//! insert a line into the database table
+bool ImportData::insert_line(const StringRef& line)
+{
+    // split line into keys and values
+    klist_type keys;
+    vlist_type values;
+    SqlStatementImpl::ptypes_type ptypes;
+    {
+        ImportTimer::Scope timer(ImportTimer::PARSE);
+        split_line(line, keys, values, ptypes);
+    }
+
+    return insert_line(line, keys, values, ptypes);
+}
+
+//! append a line to a bulk load of all fields in the field set
+bool ImportData::bulk_line(SqlBulkLoadImpl& bulk, const StringRef& line)
+{
+    // split line into keys and values
+    klist_type keys;
+    vlist_type values;
+    SqlStatementImpl::ptypes_type ptypes;
+    {
+        ImportTimer::Scope timer(ImportTimer::PARSE);
+        split_line(line, keys, values, ptypes);
+    }
+
+    return bulk_line(bulk, line, keys, values, ptypes);
+}
+
+//! append a line with given keys and values to a bulk load of all fields in
+//! the field set
+bool ImportData::bulk_line(SqlBulkLoadImpl& bulk, const StringRef& line,
+                           const klist_type& keys, const vlist_type& values,
+                           const SqlStatementImpl::ptypes_type& ptypes)
+{
+    // check for duplicate lines
+    if (is_duplicate(line)) return true;
+
+    ImportTimer::Scope timer(ImportTimer::INSERT);
+
+    // reorder values into field set columns, missing fields are NULL.
+    std::vector<int> colvalue(m_fieldset.count(), -1);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        int col = m_fieldset.find(keys[i]);
+        if (col < 0)
+            OUT_THROW("Field " << KeyTable::name(keys[i])
+                      << " not in table " << m_tablename);
+        colvalue[col] = i;
+    }
+
+    for (size_t col = 0; col < colvalue.size(); ++col)
+    {
+        int i = colvalue[col];
+
+        if (i < 0) {
+            bulk.put_null();
+        }
+        else if (ptypes.empty() ||
+                 ptypes[i] == SqlStatementImpl::PARAM_TEXT) {
+            bulk.put(values[i]);
+        }
+        else if (ptypes[i] == SqlStatementImpl::PARAM_NATIVE_INTEGER) {
+            int64_t v;
+            memcpy(&v, values[i].data(), sizeof(v));
+            bulk.put_int64(v);
+        }
+        else {
+            double v;
+            memcpy(&v, values[i].data(), sizeof(v));
+            bulk.put_double(v);
+        }
+    }
+    bulk.end_row();
+
+    return true;
+}
+
+//! process an input stream (file or stdin), cache lines or insert directly.
+void ImportData::process_stream(std::istream& is, const char* fname)
+{
+    std::string line;
+    while (std::getline(is,line))
+    {
+        if (!process_line(line))
+            return;
+    }
+
+    end_stream(fname);
+}
+
+//! split a block of data into lines, the unfinished last line is kept in line.
+bool ImportData::process_block(std::string& line, const char* data, size_t size)
+{
+    // detect binary records by the magic at the beginning of the file
+    if (m_stream_offset == 0 && line.empty() && m_binpending.empty() &&
+        BinResultDecoder::is_binary(data, size))
+    {
+        m_stream_binary = true;
+    }
+
+    if (m_stream_binary)
+        return process_binary_block(data, size);
+
+    // skip data already imported by an earlier incremental run
+    if (m_stream_skip != 0)
+    {
+        size_t skip = std::min<uint64_t>(m_stream_skip, size);
+        m_stream_skip -= skip, m_stream_offset += skip;
+        data += skip, size -= skip;
+    }
+
+    m_stream_offset += size;
+
+    return split_block(line, data, size);
+}
+
+//! split a block of data into lines without tracking the file offset, the
+//! unfinished last line is kept in line.
+bool ImportData::split_block(std::string& line, const char* data, size_t size)
+{
+    StringRef block(data, size);
+
+    std::string::size_type pos = 0, nl;
+    while ((nl = block.find('\n', pos)) != std::string::npos)
+    {
+        if (line.empty()) {
+            // complete line inside block
+            if (!process_line(block.substr(pos, nl - pos)))
+                return false;
+        }
+        else {
+            line.append(data + pos, nl - pos);
+            if (!process_line(line))
+                return false;
+            line.clear();
+        }
+        pos = nl + 1;
+    }
+    line.append(data + pos, size - pos);
+
+    return true;
+}
+
+//! decode the complete binary RESULT records in data, used is set to their
+//! number of bytes.
+bool ImportData::process_binary(const char* data, size_t size, size_t& used)
+{
+    StringRef row;
+    size_t len;
+
+    used = 0;
+
+    while ((len = m_bindecoder.decode(data + used, size - used, row)) != 0)
+    {
+        used += len;
+        m_stream_offset += len;
+
+        // keys are always read, rows only after those imported by an earlier
+        // incremental run
+        if (row.size() && m_stream_offset > m_stream_skip &&
+            !dispatch_line(row, false))
+            return false;
+    }
+
+    return true;
+}
+
+//! decode a block of binary RESULT records, the incomplete last record is
+//! kept.
+bool ImportData::process_binary_block(const char* data, size_t size)
+{
+    size_t used;
+
+    if (m_binpending.empty())
+    {
+        if (!process_binary(data, size, used)) return false;
+        m_binpending.assign(data + used, size - used);
+    }
+    else
+    {
+        m_binpending.append(data, size);
+        if (!process_binary(m_binpending.data(), m_binpending.size(), used))
+            return false;
+        m_binpending.erase(0, used);
+    }
+
+    return true;
+}
+
+//! process an input stream (file or stdin), cache lines or insert directly.
+void ImportData::process_stream(FILE* in, const char* fname)
+{
+    char buffer[64 * 1024u];
+    std::string line;
+
+    while (!feof(in))
+    {
+        size_t rb = fread(buffer, 1, sizeof(buffer), in);
+
+        if (!process_block(line, buffer, rb))
+            return;
+    }
+
+    // last line without newline, which may still be written in incremental mode
+    if (mopt_incremental)
+        m_stream_offset -= line.size();
+    else if (!line.empty() && !process_line(line))
+        return;
+
+    end_stream(fname);
+}
+
+//! process a decompressing input stream, cache lines or insert directly.
+void ImportData::process_stream(DecompressImpl& in, const char* fname)
+{
+    char buffer[64 * 1024u];
+    std::string line;
+
+    size_t rb;
+    while ((rb = in.read(buffer, sizeof(buffer))) != 0)
+    {
+        if (!process_block(line, buffer, rb))
+            return;
+    }
+
+    // last line without newline, which may still be written in incremental mode
+    if (mopt_incremental)
+        m_stream_offset -= line.size();
+    else if (!line.empty() && !process_line(line))
+        return;
+
+    end_stream(fname);
+}
+
+//! process a mapped file, lines reference the mapping and are cached without
+//! copying.
+void ImportData::process_mapped(const boost::shared_ptr<MappedFile>& file,
+                                const char* fname)
+{
+    const char* data = file->data();
+    size_t size = file->size();
+
+    // binary records are decoded, the rows do not reference the mapping
+    if (BinResultDecoder::is_binary(data, size))
+    {
+        m_stream_binary = true;
+
+        size_t used;
+        if (!process_binary(data, size, used)) return;
+        m_binpending.assign(data + used, size - used);
+
+        end_stream(fname);
+        return;
+    }
+
+    // keep mapping alive as long as cached or queued lines reference it
+    m_mappings.push_back(file);
+
+    // skip data already imported by an earlier incremental run
+    size_t pos = std::min<uint64_t>(m_stream_skip, size), nl;
+    m_stream_skip = 0;
+
+    while ((nl = StringRef(data, size).find('\n', pos)) != std::string::npos)
+    {
+        if (!process_line(StringRef(data + pos, nl - pos), true))
+            return;
+        pos = nl + 1;
+    }
+
+    // last line without newline, which may still be written in incremental mode
+    if (pos != size && !mopt_incremental) {
+        if (!process_line(StringRef(data + pos, size - pos), true))
+            return;
+        pos = size;
+    }
+
+    m_stream_offset = pos;
+
+    end_stream(fname);
+}
+
+//! Checks if the given match string is located at the end of this string.
+static inline
+bool ends_with(const std::string& str, const char* match) {
+    size_t str_size = str.size(), match_size = strlen(match);
+    if (match_size > str_size)
+        return false;
+
+    std::string::const_iterator s = str.end() - match_size;
+    while (*match != 0) {
+        if (*s != *match) return false;
+        ++s, ++match;
+    }
+    return true;
+}
+
+//! process a file, in incremental mode only the data appended since the last
+//! run.
+void ImportData::process_file(const std::string& fname, Decompress in)
+{
+    m_stream_skip = m_stream_offset = 0;
+    m_stream_binary = false;
+
+    if (!mopt_incremental)
+        return read_file(fname, in);
+
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0)
+        return read_file(fname, in);
+
+    filestate_type::const_iterator fi = m_filestate.find(fname);
+
+    if (fi != m_filestate.end())
+    {
+        if (fi->second.size == (uint64_t)st.st_size &&
+            fi->second.mtime == (uint64_t)st.st_mtime)
+        {
+            if (mopt_verbose >= 1)
+                OUT("No new data in " << fname);
+            return;
+        }
+
+        // resume after the last complete line, rewritten files were checked
+        // by rewritten_file(). For compressed files the offset counts
+        // decompressed bytes.
+        m_stream_skip = fi->second.offset;
+    }
+
+    if (mopt_verbose >= 1 && m_stream_skip != 0)
+        OUT("Resuming " << fname << " at offset " << m_stream_skip);
+
+    read_file(fname, in);
+
+    FileState& fs = m_filestate[fname];
+    fs.inode = st.st_ino;
+    fs.size = st.st_size;
+    fs.mtime = st.st_mtime;
+    fs.offset = m_stream_offset;
+}
+
+//! read a file, decompressing it if necessary.
+void ImportData::read_file(const std::string& fname, Decompress in)
+{
+    if (DecompressImpl::is_compressed(fname)) {
+        // decompress in-process, unless already opened by the caller
+        if (!in) in = DecompressImpl::open(fname);
+
+        if (!in) {
+            if (mopt_empty_okay)
+                OUT("Error reading " << fname << ": " << strerror(errno));
+            else
+                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
+        }
+        else {
+            process_stream(*in, fname.c_str());
+        }
+    }
+    else if (ends_with(fname, ".gz")) {
+        FILE* in = popen(("gzip -dc " + fname).c_str(), "r");
+        if (in == NULL) {
+            if (mopt_empty_okay)
+                OUT("Error reading " << fname << ": " << strerror(errno));
+            else
+                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
+        }
+        else {
+            process_stream(in, fname.c_str());
+            pclose(in);
+        }
+    }
+    else if (ends_with(fname, ".bz2")) {
+        FILE* in = popen(("bzip2 -dc " + fname).c_str(), "r");
+        if (in == NULL) {
+            if (mopt_empty_okay)
+                OUT("Error reading " << fname << ": " << strerror(errno));
+            else
+                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
+        }
+        else {
+            process_stream(in, fname.c_str());
+            pclose(in);
+        }
+    }
+    else if (ends_with(fname, ".xz")) {
+        FILE* in = popen(("xz -dc " + fname).c_str(), "r");
+        if (in == NULL) {
+            if (mopt_empty_okay)
+                OUT("Error reading " << fname << ": " << strerror(errno));
+            else
+                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
+        }
+        else {
+            process_stream(in, fname.c_str());
+            pclose(in);
+        }
+    }
+    else {
+        // map regular files and read lines without copying
+        boost::shared_ptr<MappedFile> file(new MappedFile);
+        if (file->open(fname)) {
+            process_mapped(file, fname.c_str());
+            return;
+        }
+        else if (errno != 0) {
+            if (mopt_empty_okay)
+                OUT("Error reading " << fname << ": " << strerror(errno));
+            else
+                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
+            return;
+        }
+
+        // empty or special files are read as streams
+        std::ifstream in(fname.c_str());
+        if (!in.good()) {
+            if (mopt_empty_okay)
+                OUT("Error reading " << fname << ": " << strerror(errno));
+            else
+                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
+        }
+        else {
+            process_stream(in, fname.c_str());
+        }
+    }
+}
+
+//! name of the table holding the state of incremental imports
+static const char* filestate_table = "sqlplot_import_state";
+
+//! name of the table holding the state of incremental imports into TEMPORARY
+//! tables, which is itself temporary and hence not persisted.
+static const char* filestate_temp_table = "sqlplot_import_state_temp";
+
+//! return the quoted name of the state table for the target table
+std::string ImportData::filestate_name() const
+{
+    return m_db->quote_field(
+        mopt_temporary_table ? filestate_temp_table : filestate_table);
+}
+
+//! return the first of the files which was replaced, truncated or rewritten
+//! since its lines were imported, or an empty string. Rows imported from it
+//! cannot be told apart from the new ones.
+std::string ImportData::rewritten_file(const std::vector<std::string>& files) const
+{
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        filestate_type::const_iterator fi = m_filestate.find(files[i]);
+        if (fi == m_filestate.end()) continue;
+
+        struct stat st;
+        if (stat(files[i].c_str(), &st) != 0) continue;
+
+        if (fi->second.inode != (uint64_t)st.st_ino ||
+            fi->second.size > (uint64_t)st.st_size ||
+            (fi->second.size == (uint64_t)st.st_size &&
+             fi->second.mtime != (uint64_t)st.st_mtime))
+            return files[i];
+    }
+
+    return std::string();
+}
+
+//! load state of incremental imports into the table
+void ImportData::load_file_state()
+{
+    std::ostringstream cmd;
+    cmd << "CREATE " << (mopt_temporary_table ? "TEMPORARY " : "")
+        << "TABLE IF NOT EXISTS " << filestate_name()
+        << " (tablename " << FieldSet::sqlname(FieldSet::T_VARCHAR, m_db->type())
+        << ", filename " << FieldSet::sqlname(FieldSet::T_VARCHAR, m_db->type())
+        << ", inode BIGINT, filesize BIGINT, mtime BIGINT, fileoffset BIGINT)";
+    m_db->execute(cmd.str());
+
+    m_filestate.clear();
+
+    std::vector<std::string> params(1, m_tablename);
+
+    if (!m_db->exist_table(m_tablename))
+    {
+        // table was dropped: import all files again
+        m_db->prepare(
+            "DELETE FROM " + filestate_name() +
+            " WHERE tablename = " + m_db->placeholder(0))->execute(params);
+        return;
+    }
+
+    // the existing table is continued by create_table()
+    SqlQuery sql = m_db->query(
+        "SELECT filename, inode, filesize, mtime, fileoffset FROM " +
+        filestate_name() +
+        " WHERE tablename = " + m_db->placeholder(0), params);
+
+    while (sql->step())
+    {
+        FileState& fs = m_filestate[sql->text(0)];
+        fs.inode = strtoull(sql->text(1).c_str(), NULL, 10);
+        fs.size = strtoull(sql->text(2).c_str(), NULL, 10);
+        fs.mtime = strtoull(sql->text(3).c_str(), NULL, 10);
+        fs.offset = strtoull(sql->text(4).c_str(), NULL, 10);
+    }
+}
+
+//! save state of incremental imports into the table
+void ImportData::save_file_state()
+{
+    std::vector<std::string> params(1, m_tablename);
+
+    m_db->prepare(
+        "DELETE FROM " + filestate_name() +
+        " WHERE tablename = " + m_db->placeholder(0))->execute(params);
+
+    std::ostringstream cmd;
+    cmd << "INSERT INTO " << filestate_name()
+        << " (tablename, filename, inode, filesize, mtime, fileoffset) VALUES (";
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        if (i != 0) cmd << ',';
+        cmd << m_db->placeholder(i);
+    }
+    cmd << ')';
+
+    SqlStatement stmt = m_db->prepare(cmd.str());
+
+    for (filestate_type::const_iterator fi = m_filestate.begin();
+         fi != m_filestate.end(); ++fi)
+    {
+        std::string num[4] = {
+            to_str(fi->second.inode), to_str(fi->second.size),
+            to_str(fi->second.mtime), to_str(fi->second.offset)
+        };
+
+        params.resize(2);
+        params[1] = fi->first;
+        params.insert(params.end(), num, num + 4);
+
+        stmt->execute(params);
+    }
+}
+
+//! split a RESULT line into keys, values and types (thread-safe)
+void ImportData::parse_line(ParsedLine& pl) const
+{
+    {
+        ImportTimer::Scope timer(ImportTimer::PARSE);
+        split_line(pl.line, pl.keys, pl.values, pl.ptypes);
+    }
+
+    ImportTimer::Scope timer(ImportTimer::DETECT);
+
+    pl.types.resize(pl.values.size());
+
+    if (pl.ptypes.empty())
+    {
+        for (size_t i = 0; i < pl.values.size(); ++i)
+            pl.types[i] = FieldSet::detect(pl.values[i]);
+    }
+    else
+    {
+        // binary rows carry the types of numbers
+        for (size_t i = 0; i < pl.values.size(); ++i)
+            pl.types[i] = BinResultDecoder::detect(pl.values[i], pl.ptypes[i]);
+    }
+}
+
+//! process a parsed line: cache lines or insert directly.
+bool ImportData::process_parsed(ParsedLine& pl)
+{
+    if (mopt_verbose >= 2)
+        OUT("line: " << printable_line(pl.line));
+
+    if (!mopt_firstline)
+    {
+        // augment types of each field
+        {
+            ImportTimer::Scope timer(ImportTimer::DETECT);
+            for (size_t i = 0; i < pl.keys.size(); ++i)
+                m_fieldset.add_field(pl.keys[i], pl.types[i]);
+        }
+
+        if (m_spill)
+        {
+            // write split line to spill file
+            m_spill->write(pl.line, pl.keys, pl.values);
+        }
+        else
+        {
+            // cache line, copy it unless it stays mapped
+            m_linedata.push_back(
+                pl.stable ? pl.line : m_linearena.append(pl.line));
+
+            // start spilling once the cache is too large
+            if (mopt_spill_limit != 0 &&
+                m_linearena.total() + m_linedata.size() * sizeof(StringRef)
+                >= mopt_spill_limit)
+            {
+                if (mopt_verbose >= 1)
+                    OUT("Cached lines exceed memory limit, spilling to disk.");
+
+                m_spill.reset(new SpillFile);
+            }
+        }
+        ++m_count, ++m_total_count;
+    }
+    else
+    {
+        if (m_total_count == 0)
+        {
+            // take types of each field from first row
+            for (size_t i = 0; i < pl.keys.size(); ++i)
+                m_fieldset.add_field(pl.keys[i], pl.types[i]);
+
+            // immediately create table from first row
+            if (!create_table()) return false;
+        }
+        else if (mopt_single_pass)
+        {
+            // add new columns and widen types of existing ones
+            widen_schema(pl);
+        }
+
+        if (insert_line(pl.line, pl.keys, pl.values, pl.ptypes)) {
+            ++m_count, ++m_total_count;
+        }
+    }
+
+    return true;
+}
+
+//! process a line: cache lines or insert directly.
+bool ImportData::process_line(const StringRef& line, bool stable)
+{
+    if (!mopt_all_lines && is_result_line(line) == 0)
+        return true;
+
+    // a zero byte marks decoded binary rows, hence such lines are not text
+    if (BinResultDecoder::is_row(line))
+        return true;
+
+    return dispatch_line(line, stable);
+}
+
+//! parse a RESULT line or decoded binary row, or queue it for the parser
+//! threads.
+bool ImportData::dispatch_line(const StringRef& line, bool stable)
+{
+    if (m_pipeline)
+    {
+        // collect line into chunk for the parser threads
+        m_chunk.lines.push_back(ParsedLine());
+        m_chunk.lines.back().line =
+            stable ? line : m_chunk.arena.append(line);
+        m_chunk.lines.back().stable = stable;
+
+        if (m_chunk.lines.size() >= 4096)
+            push_chunk();
+
+        return true;
+    }
+
+    ParsedLine pl;
+    pl.line = line;
+    pl.stable = stable;
+    parse_line(pl);
+
+    return process_parsed(pl);
+}
+
+//! parse all lines of a chunk, run by the worker threads
+void ImportData::parse_chunk(LineChunk& chunk) const
+{
+    for (size_t i = 0; i < chunk.lines.size(); ++i)
+        parse_line(chunk.lines[i]);
+}
+
+//! process lines of a parsed chunk, run by the writer thread
+void ImportData::write_chunk(LineChunk& chunk)
+{
+    for (size_t i = 0; i < chunk.lines.size(); ++i)
+    {
+        if (!process_parsed(chunk.lines[i]))
+            OUT_THROW("Import into table " << m_tablename << " stopped.");
+    }
+
+    if (!chunk.eof_fname.empty())
+        finish_stream(chunk.eof_fname);
+}
+
+//! push the reader's current chunk into the pipeline
+void ImportData::push_chunk()
+{
+    m_pipeline->push(std::move(m_chunk));
+    m_chunk = LineChunk();
+}
+
+//! output number of rows read from an input stream
+void ImportData::finish_stream(const std::string& fname)
+{
+    if (mopt_firstline) {
+        OUT("Imported " << m_count << " rows of data from " << fname);
+    }
+    else {
+        OUT("Cached " << m_count << " rows of data from " << fname);
+    }
+
+    m_count = 0;
+}
+
+//! mark end of an input stream, maybe after queued lines are processed
+void ImportData::end_stream(const char* fname)
+{
+    // an incomplete binary record may still be written in incremental mode
+    if (!m_binpending.empty() && !mopt_incremental)
+        OUT("Ignoring truncated binary RESULT record at the end of " << fname);
+    m_binpending.clear();
+
+    if (m_pipeline)
+    {
+        m_chunk.eof_fname = fname;
+        push_chunk();
+    }
+    else
+    {
+        finish_stream(fname);
+    }
+}
+
+//! replace the table by one kept in typed in-memory columns, returns an
+//! empty pointer if the database does not support them.
+SqlBulkLoad ImportData::create_columnar()
+{
+    if (m_db->exist_table(m_tablename))
+    {
+        OUT("Table \"" << m_tablename << "\" exists. Replacing data.");
+        m_db->execute("DROP TABLE " + m_db->quote_field(m_tablename));
+    }
+
+    SqlBulkLoad bulk = m_db->columnar_table(m_tablename, m_fieldset);
+
+    if (bulk && mopt_verbose >= 1)
+        OUT("Keeping table \"" << m_tablename << "\" in memory columns.");
+
+    return bulk;
+}
+
+//! process cached data lines
+void ImportData::process_linedata()
+{
+    SqlBulkLoad bulk;
+
+    if (mopt_columnar)
+        bulk = create_columnar();
+
+    if (!bulk && !create_table()) return;
+
+    // use the database's bulk loading facility, if it has one.
+    if (!bulk && (!m_linedata.empty() || m_spill))
+    {
+        std::vector<std::string> cols(m_fieldset.count());
+        for (size_t i = 0; i < cols.size(); ++i)
+            cols[i] = m_fieldset.key(i);
+
+        bulk = m_db->bulk_load(m_tablename, cols);
+    }
+
+    for (vlist_type::const_iterator line = m_linedata.begin();
+         line != m_linedata.end(); ++line)
+    {
+        if (bulk ? bulk_line(*bulk, *line) : insert_line(*line)) {
+            ++m_count, ++m_total_count;
+        }
+    }
+
+    // replay rows spilled to disk, which are already split
+    if (m_spill)
+    {
+        if (mopt_verbose >= 1)
+            OUT("Reading " << m_spill->rows() << " spilled rows ("
+                << m_spill->bytes() << " bytes).");
+
+        m_spill->rewind();
+
+        StringRef line;
+        klist_type keys;
+        vlist_type values;
+        SqlStatementImpl::ptypes_type ptypes;
+
+        while (m_spill->read(line, keys, values))
+        {
+            // the parameter types of binary rows are not spilled
+            if (BinResultDecoder::is_row(line))
+                split_line(line, keys, values, ptypes);
+            else
+                ptypes.clear();
+
+            if (bulk ? bulk_line(*bulk, line, keys, values, ptypes)
+                : insert_line(line, keys, values, ptypes)) {
+                ++m_count, ++m_total_count;
+            }
+        }
+    }
+
+    if (bulk) {
+        ImportTimer::Scope timer(ImportTimer::INSERT);
+        bulk->finish();
+    }
+}
+
+//! measure phases, for the import benchmark
+bool ImportTimer::enabled = false;
+
+//! accumulated nanoseconds of each phase
+std::atomic<uint64_t> ImportTimer::nanos[ImportTimer::NUM_PHASES];
+
+//! set by SIGINT and SIGTERM to stop following files
+static volatile sig_atomic_t s_follow_stop = 0;
+
+//! signal handler to stop following files
+static void follow_signal(int)
+{
+    s_follow_stop = 1;
+}
+
+//! install follow_signal for SIGINT and SIGTERM and block both, such that they
+//! are only delivered while waiting in follow_poll() with waitmask. Otherwise
+//! a signal arriving between checking s_follow_stop and waiting is missed.
+static void follow_signals_begin(sigset_t& oldmask, sigset_t& waitmask)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = follow_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    sigset_t block;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &oldmask);
+
+    waitmask = oldmask;
+    sigdelset(&waitmask, SIGINT);
+    sigdelset(&waitmask, SIGTERM);
+}
+
+//! restore default handlers of SIGINT and SIGTERM and the signal mask
+static void follow_signals_end(const sigset_t& oldmask)
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+    s_follow_stop = 0;
+}
+
+//! poll for up to timeout milliseconds, or infinitely if negative, while
+//! SIGINT and SIGTERM can interrupt the wait.
+static int follow_poll(struct pollfd* fds, nfds_t nfds, long timeout,
+                       const sigset_t& waitmask)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
+
+    return ppoll(fds, nfds, timeout < 0 ? NULL : &ts, &waitmask);
+}
+
+//! expand glob patterns into the list of existing files
+static std::vector<std::string>
+glob_files(const std::vector<std::string>& patterns)
+{
+    std::vector<std::string> files;
+
+    CSimpleGlob glob(SG_GLOB_NODOT | SG_GLOB_ONLYFILE | SG_GLOB_TILDE);
+
+    for (size_t i = 0; i < patterns.size(); ++i)
+    {
+        if (glob.Add(patterns[i].c_str()) < SG_SUCCESS)
+            OUT_THROW("Error while globbing files");
+    }
+
+    for (int i = 0; i < glob.FileCount(); ++i)
+        files.push_back(glob.File(i));
+
+    return files;
+}
+
+//! return directory part of a path
+static std::string dir_name(const std::string& path)
+{
+    std::string::size_type slash = path.rfind('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+//! sum of bytes appended to files since they were last read
+uint64_t ImportData::pending_bytes(const std::vector<std::string>& files) const
+{
+    uint64_t pending = 0;
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        struct stat st;
+        if (stat(files[i].c_str(), &st) != 0) continue;
+
+        filestate_type::const_iterator fi = m_filestate.find(files[i]);
+        uint64_t size = (fi == m_filestate.end()) ? 0 : fi->second.size;
+
+        if ((uint64_t)st.st_size > size)
+            pending += st.st_size - size;
+    }
+
+    return pending;
+}
+
+//! watch files matching the patterns with inotify and import appended lines
+//! in batched transactions until interrupted.
+void ImportData::follow(const std::vector<std::string>& patterns)
+{
+    // non-blocking, such that reading drains the queued events and stops
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0)
+        OUT_THROW("Error initializing inotify: " << strerror(errno));
+
+    // watch directories to see both appended data and new files
+    std::set<std::string> dirs;
+    for (size_t i = 0; i < patterns.size(); ++i)
+        dirs.insert(dir_name(patterns[i]));
+
+    for (std::set<std::string>::const_iterator di = dirs.begin();
+         di != dirs.end(); ++di)
+    {
+        if (inotify_add_watch(fd, di->c_str(),
+                              IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0)
+        {
+            close(fd);
+            OUT_THROW("Error watching " << *di << ": " << strerror(errno));
+        }
+    }
+
+    // stop cleanly on interrupt, after committing the current batch
+    sigset_t oldmask, waitmask;
+    follow_signals_begin(oldmask, waitmask);
+
+    OUT("Following " << patterns.size() << " file patterns, interrupt to stop.");
+
+    char buffer[16 * 1024];
+
+    // errors stop following, after the transaction and watches are released
+    std::exception_ptr error;
+    bool in_batch = false;
+
+    try
+    {
+        std::vector<std::string> files = glob_files(patterns);
+
+        while (!s_follow_stop)
+        {
+            // wait for the first event
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (follow_poll(&pfd, 1, -1, waitmask) <= 0) continue;
+
+            // collect further events for a while to batch rows, unless
+            // enough data is waiting already.
+            std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(mopt_follow_interval);
+
+            while (!s_follow_stop)
+            {
+                // drain queued events until EAGAIN
+                ssize_t rb;
+                while ((rb = read(fd, buffer, sizeof(buffer))) > 0) { }
+
+                if (rb < 0 && errno != EAGAIN && errno != EINTR)
+                    OUT_THROW("Error reading inotify events: " << strerror(errno));
+
+                if (pending_bytes(files) >= mopt_follow_batch) break;
+
+                long wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (wait <= 0) break;
+
+                if (follow_poll(&pfd, 1, wait, waitmask) == 0) break;
+            }
+
+            // import all appended lines in one transaction
+            files = glob_files(patterns);
+
+            std::string rewritten = rewritten_file(files);
+
+            if (!rewritten.empty())
+            {
+                OUT_THROW("File " << rewritten << " was rewritten while following. "
+                          "Run again to import all files into table \"" <<
+                          m_tablename << "\" anew.");
+            }
+
+            size_t total_before = m_total_count;
+
+            m_db->execute("BEGIN");
+            in_batch = true;
+
+            for (size_t i = 0; i < files.size(); ++i)
+                process_file(files[i]);
+
+            save_file_state();
+
+            m_db->execute("COMMIT");
+            in_batch = false;
+
+            // all lines were inserted, mappings are not needed anymore
+            m_mappings.clear();
+
+            if (!mopt_fingerprint_file.empty())
+            {
+                FingerprintSet::append(mopt_fingerprint_file, m_new_fingerprints);
+                m_new_fingerprints.clear();
+            }
+
+            if (m_total_count != total_before)
+                OUT("Committed " << m_total_count - total_before << " new rows, "
+                    << m_total_count << " in total.");
+        }
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // discard the rows of the failed batch
+    if (in_batch)
+    {
+        m_insert_cache.clear();
+
+        try {
+            m_db->execute("ROLLBACK");
+        }
+        catch (std::runtime_error& e) {
+            OUT("Error rolling back: " << e.what());
+        }
+    }
+
+    close(fd);
+
+    follow_signals_end(oldmask);
+
+    m_insert_cache.clear();
+    m_mappings.clear();
+
+    if (error) std::rethrow_exception(error);
+}
+
+//! open a listening socket: a TCP port on localhost if address is a number,
+//! otherwise a Unix domain socket at the path address.
+static int listen_socket(const std::string& address)
+{
+    unsigned int port;
+    int fd;
+
+    if (from_str(address, port) && port < 65536)
+    {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            OUT_THROW("Error creating socket: " << strerror(errno));
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+            close(fd);
+            OUT_THROW("Error binding to port " << port << ": " << strerror(errno));
+        }
+    }
+    else
+    {
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+
+        if (address.size() >= sizeof(sa.sun_path))
+            OUT_THROW("Socket path " << address << " is too long.");
+        memcpy(sa.sun_path, address.data(), address.size());
+
+        // replace a stale socket of an earlier run, but no other file
+        struct stat st;
+        if (stat(address.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            unlink(address.c_str());
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            OUT_THROW("Error creating socket: " << strerror(errno));
+
+        if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+            close(fd);
+            OUT_THROW("Error binding to " << address << ": " << strerror(errno));
+        }
+    }
+
+    if (listen(fd, 64) != 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        close(fd);
+        OUT_THROW("Error listening on " << address << ": " << strerror(errno));
+    }
+
+    return fd;
+}
+
+//! listen on a Unix domain socket or localhost TCP port and import the lines
+//! streamed by clients in batched transactions until interrupted.
+void ImportData::serve(const std::string& address)
+{
+    typedef std::chrono::steady_clock clock;
+
+    int lfd = listen_socket(address);
+
+    // stop cleanly on interrupt, after committing the current batch
+    sigset_t oldmask, waitmask;
+    follow_signals_begin(oldmask, waitmask);
+    signal(SIGPIPE, SIG_IGN);
+
+    OUT("Serving imports into table \"" << m_tablename << "\" on " << address
+        << ", interrupt to stop.");
+
+    // the listening socket comes first, then one entry per client
+    std::vector<struct pollfd> pfds(1);
+    pfds[0].fd = lfd;
+    pfds[0].events = POLLIN;
+
+    // unfinished last line of each client
+    std::vector<std::string> lines(1);
+
+    char buffer[64 * 1024];
+
+    // current batch, which is open if it has a start time
+    bool in_batch = false;
+    clock::time_point batch_start;
+    uint64_t batch_bytes = 0;
+    size_t batch_rows = m_total_count;
+
+    // totals for the throughput summary
+    clock::time_point serve_start = clock::now();
+    uint64_t total_bytes = 0;
+    size_t connections = 0;
+
+    // errors of clients stop serving, after the sockets are released
+    std::exception_ptr error;
+
+    try
+    {
+        while (!s_follow_stop)
+        {
+            long timeout = -1;
+            if (in_batch)
+            {
+                timeout = std::max<long>(
+                    0, mopt_follow_interval -
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        clock::now() - batch_start).count());
+            }
+
+            if (follow_poll(pfds.data(), pfds.size(), timeout, waitmask) < 0 &&
+                errno != EINTR)
+                OUT_THROW("Error polling sockets: " << strerror(errno));
+
+            // accept new clients
+            if (pfds[0].revents & POLLIN)
+            {
+                int cfd;
+                while ((cfd = accept4(lfd, NULL, NULL,
+                                      SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0)
+                {
+                    struct pollfd p = { cfd, POLLIN, 0 };
+                    pfds.push_back(p);
+                    lines.push_back(std::string());
+                    ++connections;
+
+                    if (mopt_verbose >= 1)
+                        OUT("Client connected, " << pfds.size() - 1 << " in total.");
+                }
+            }
+
+            // read lines from clients, each is inserted immediately
+            for (size_t i = 1; i < pfds.size(); ++i)
+            {
+                if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+                ssize_t rb = read(pfds[i].fd, buffer, sizeof(buffer));
+
+                if (rb < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+
+                if (rb > 0 || !lines[i].empty())
+                {
+                    if (!in_batch) {
+                        m_db->execute("BEGIN");
+                        in_batch = true;
+                        batch_start = clock::now();
+                    }
+
+                    if (rb > 0) {
+                        batch_bytes += rb;
+                        split_block(lines[i], buffer, rb);
+                        continue;
+                    }
+
+                    // last line without newline of a closed connection
+                    process_line(lines[i]);
+                }
+
+                close(pfds[i].fd);
+                pfds.erase(pfds.begin() + i);
+                lines.erase(lines.begin() + i);
+                --i;
+
+                if (mopt_verbose >= 1)
+                    OUT("Client disconnected, " << pfds.size() - 1 << " remaining.");
+            }
+
+            // commit the batch after the interval or once enough data arrived
+            if (!in_batch) continue;
+
+            clock::time_point now = clock::now();
+
+            if (now - batch_start < std::chrono::milliseconds(mopt_follow_interval) &&
+                batch_bytes < mopt_follow_batch && !s_follow_stop)
+                continue;
+
+            m_db->execute("COMMIT");
+            in_batch = false;
+
+            if (!mopt_fingerprint_file.empty())
+            {
+                FingerprintSet::append(mopt_fingerprint_file, m_new_fingerprints);
+                m_new_fingerprints.clear();
+            }
+
+            double secs = std::chrono::duration<double>(now - batch_start).count();
+            if (secs <= 0) secs = 1e-9;
+
+            OUT("Committed " << m_total_count - batch_rows << " new rows from "
+                << pfds.size() - 1 << " clients, "
+                << (size_t)((m_total_count - batch_rows) / secs) << " rows/s, "
+                << batch_bytes / secs / (1024 * 1024) << " MiB/s, "
+                << m_total_count << " in total.");
+
+            total_bytes += batch_bytes;
+            batch_bytes = 0;
+            batch_rows = m_total_count;
+        }
+
+        if (in_batch) {
+            m_db->execute("COMMIT");
+            in_batch = false;
+        }
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // discard the rows of the failed batch
+    if (in_batch)
+    {
+        try {
+            m_db->execute("ROLLBACK");
+        }
+        catch (std::runtime_error& e) {
+            OUT("Error rolling back: " << e.what());
+        }
+    }
+
+    for (size_t i = 0; i < pfds.size(); ++i)
+        close(pfds[i].fd);
+
+    // remove Unix domain socket
+    unsigned int port;
+    if (!from_str(address, port))
+        unlink(address.c_str());
 
-            std::ostringstream cmd;
-            cmd << "DROP TABLE " << g_db->quote_field(m_tablename);
+    follow_signals_end(oldmask);
+    signal(SIGPIPE, SIG_DFL);
 
-            g_db->execute(cmd.str());
+    m_insert_cache.clear();
 
-            g_db->execute(createtable);
-        }
-        else {
-            throw; // other databases have real errors.
-        }
-    }
+    if (error) std::rethrow_exception(error);
 
-    return true;
+    double secs = std::chrono::duration<double>(clock::now() - serve_start).count();
+
+    OUT("Served " << connections << " connections, imported "
+        << m_total_count << " rows (" << total_bytes + batch_bytes
+        << " bytes) in " << secs << " s, "
+        << (size_t)(m_total_count / secs) << " rows/s on average.");
 }
 
-//! insert a line into the database table
-bool ImportData::insert_line(const std::string& line)
+//! read files and insert their lines into the table
+void ImportData::read_files(const std::vector<std::string>& files)
 {
-    // check for duplicate lines
-    if (mopt_noduplicates)
+    // load offsets of files imported earlier
+    if (mopt_incremental)
     {
-        if (m_lineset.find(line) != m_lineset.end())
+        load_file_state();
+
+        std::string fname = rewritten_file(files);
+
+        if (!fname.empty())
         {
-            if (mopt_verbose >= 1)
-                OUT("Dropping duplicate " << line);
-            return true;
-        }
+            // rows of the old file are in the table: import all files again
+            OUT("File " << fname << " was rewritten since the last run. "
+                "Importing all files into table \"" << m_tablename << "\" again.");
 
-        m_lineset.insert(line);
-    }
+            std::ostringstream cmd;
+            cmd << "DROP TABLE " << m_db->quote_field(m_tablename);
+            m_db->execute(cmd.str());
 
-    // split line and construct INSERT command
-    slist_type slist = split_result_line(line);
+            m_filestate.clear();
+        }
+    }
 
-    std::set<std::string> keyset;
+    // start parser threads and a writer thread for the database
+    if (mopt_threads > 0)
+    {
+        using namespace std::placeholders;
 
-    std::ostringstream cmd;
-    cmd << "INSERT INTO " << g_db->quote_field(m_tablename) << " (";
+        m_pipeline.reset(
+            new pipeline_type(
+                mopt_threads,
+                std::bind(&ImportData::parse_chunk, this, _1),
+                std::bind(&ImportData::write_chunk, this, _1)));
+    }
 
-    std::vector<std::string> paramValues(slist.size());
+    // with parser threads, also decompress the next files in parallel
+    std::deque<Decompress> ahead;
+    size_t next = 0;
 
-    for (size_t i = 0; i < slist.size(); ++i)
+    for (size_t fi = 0; fi < files.size(); ++fi)
     {
-        if (slist[i].size() == 0) continue;
+        for ( ; mopt_threads > 0 && next < files.size() &&
+                  next < fi + mopt_threads; ++next)
+        {
+            Decompress in;
+            if (DecompressImpl::is_compressed(files[next])) {
+                in = DecompressImpl::open(files[next]);
+                if (in) in = DecompressImpl::read_ahead(in);
+            }
+            ahead.push_back(in);
+        }
+
+        Decompress in;
+        if (!ahead.empty()) {
+            in = ahead.front();
+            ahead.pop_front();
+        }
 
-        std::string key;
-        split_keyvalue(slist[i], i, key, paramValues[i]);
+        process_file(files[fi], in);
+    }
 
-        key = dedup_key(key, keyset);
+    // wait for parser threads and writer to process all lines
+    if (m_pipeline)
+    {
+        if (!m_chunk.lines.empty())
+            push_chunk();
 
-        if (i != 0) cmd << ',';
-        cmd << g_db->quote_field(key);
+        m_pipeline->finish();
+        m_pipeline.reset();
     }
 
-    cmd << ") VALUES (";
-    for (size_t i = 0; i < slist.size(); ++i)
+    // process cached data lines
+    if (!mopt_firstline)
     {
-        if (i != 0) cmd << ',';
-        cmd << g_db->placeholder(i);
+        m_count = m_total_count = 0;
+        process_linedata();
     }
-    cmd << ')';
 
-    if (mopt_verbose >= 2) OUT(cmd.str());
+    // save offsets of imported files in the same transaction
+    if (mopt_incremental)
+        save_file_state();
 
-    g_db->query(cmd.str(), paramValues);
+    // release prepared statements before the connection may be closed
+    m_insert_cache.clear();
 
-    return true;
+    // release cached lines and the mapped files they reference
+    m_linedata.clear();
+    m_linearena.clear();
+    m_mappings.clear();
+    m_spill.reset();
 }
 
-//! process an input stream (file or stdin), cache lines or insert directly.
-void ImportData::process_stream(std::istream& is, const char* fname)
+//! import files into the table in one transaction
+void ImportData::import_files(const std::vector<std::string>& files)
 {
-    m_count = 0;
+    // begin transaction
+    m_db->execute("BEGIN");
 
-    std::string line;
-    while (std::getline(is,line))
+    try
     {
-        if (!process_line(line))
-            return;
-    }
-
-    if (mopt_firstline) {
-        OUT("Imported " << m_count << " rows of data from " << fname);
+        read_files(files);
     }
-    else {
-        OUT("Cached " << m_count << " rows of data from " << fname);
+    catch (...)
+    {
+        // stop parser threads before aborting the transaction
+        m_pipeline.reset();
+        m_insert_cache.clear();
+        m_db->execute("ROLLBACK");
+        throw;
     }
-}
 
-//! scan string of given size for ch starting at pos and return position or
-//! std::string::npos
-static inline
-size_t string_find(const char* str, size_t size, char ch, size_t pos) {
-    while (pos < size) {
-        if (str[pos] == ch)
-            return pos;
-        ++pos;
-    }
-    return std::string::npos;
+    // finish transaction
+    ImportTimer::Scope timer(ImportTimer::INSERT);
+    m_db->execute("COMMIT");
 }
 
-//! process an input stream (file or stdin), cache lines or insert directly.
-void ImportData::process_stream(FILE* in, const char* fname)
+//! split files into num contiguous groups of about equal size in bytes, such
+//! that concatenating the groups keeps the original order.
+static std::vector< std::vector<std::string> >
+split_files(const std::vector<std::string>& files, size_t num)
 {
-    m_count = 0;
-
-    char buffer[64 * 1024u];
-    std::string line;
+    std::vector<uint64_t> sizes(files.size());
+    uint64_t total = 0;
 
-    while (!feof(in))
+    for (size_t i = 0; i < files.size(); ++i)
     {
-        size_t rb = fread(buffer, 1, sizeof(buffer), in);
-
-        std::string::size_type pos = 0, nl;
-        while ((nl = string_find(buffer, rb, '\n', pos)) != std::string::npos) {
-            line.append(buffer + pos, nl - pos);
-            if (!process_line(line))
-                return;
-            line.clear();
-            pos = nl + 1;
-        }
-        line.append(buffer + pos, rb - pos);
+        struct stat st;
+        sizes[i] = (stat(files[i].c_str(), &st) == 0) ? st.st_size : 0;
+        total += sizes[i];
     }
 
-    if (mopt_firstline) {
-        OUT("Imported " << m_count << " rows of data from " << fname);
-    }
-    else {
-        OUT("Cached " << m_count << " rows of data from " << fname);
-    }
-}
-
-//! Checks if the given match string is located at the end of this string.
-static inline
-bool ends_with(const std::string& str, const char* match) {
-    size_t str_size = str.size(), match_size = strlen(match);
-    if (match_size > str_size)
-        return false;
+    std::vector< std::vector<std::string> > groups;
+    uint64_t sum = 0;
 
-    std::string::const_iterator s = str.end() - match_size;
-    while (*match != 0) {
-        if (*s != *match) return false;
-        ++s, ++match;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        // start next group once its share of the total size is reached
+        if (groups.empty() ||
+            (groups.size() < num && sum >= total / num * groups.size() &&
+             !groups.back().empty()))
+            groups.push_back(std::vector<std::string>());
+
+        groups.back().push_back(files[i]);
+        sum += sizes[i];
     }
-    return true;
+
+    return groups;
 }
 
-//! process a line: cache lines or insert directly.
-void ImportData::process_file(const std::string& fname)
+//! import the files with one thread per shard, each into its own temporary
+//! SQLite database, and merge the shards into the table in file order.
+void ImportData::import_sharded(const std::vector<std::string>& files)
 {
-    if (ends_with(fname, ".gz")) {
-        FILE* in = popen(("gzip -dc " + fname).c_str(), "r");
-        if (in == NULL) {
-            if (mopt_empty_okay)
-                OUT("Error reading " << fname << ": " << strerror(errno));
-            else
-                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
-        }
-        else {
-            process_stream(in, fname.c_str());
-            pclose(in);
-        }
-    }
-    else if (ends_with(fname, ".bz2")) {
-        FILE* in = popen(("bzip2 -dc " + fname).c_str(), "r");
-        if (in == NULL) {
-            if (mopt_empty_okay)
-                OUT("Error reading " << fname << ": " << strerror(errno));
-            else
-                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
-        }
-        else {
-            process_stream(in, fname.c_str());
-            pclose(in);
-        }
-    }
-    else if (ends_with(fname, ".xz")) {
-        FILE* in = popen(("xz -dc " + fname).c_str(), "r");
-        if (in == NULL) {
-            if (mopt_empty_okay)
-                OUT("Error reading " << fname << ": " << strerror(errno));
-            else
-                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
-        }
-        else {
-            process_stream(in, fname.c_str());
-            pclose(in);
-        }
-    }
-    else {
-        std::ifstream in(fname.c_str());
-        if (!in.good()) {
-            if (mopt_empty_okay)
-                OUT("Error reading " << fname << ": " << strerror(errno));
-            else
-                OUT_THROW("Error reading " << fname << ": " << strerror(errno));
-        }
-        else {
-            process_stream(in, fname.c_str());
-        }
+    if (mopt_noduplicates || mopt_incremental)
+        OUT_THROW("Sharded import cannot be combined with -d, -F, -I or --follow.");
+
+    // all shards are attached at once to merge them in one transaction,
+    // SQLite attaches at most ten databases by default.
+    static const size_t max_shards = 10;
+
+    if (mopt_shards > max_shards)
+    {
+        OUT("Reducing to " << max_shards << " shards, the number of databases "
+            "SQLite can attach.");
+        mopt_shards = max_shards;
     }
-}
 
-//! process a line: cache lines or insert directly.
-bool ImportData::process_line(const std::string& line)
-{
-    if (!mopt_all_lines && is_result_line(line) == 0)
-        return true;
+    std::vector< std::vector<std::string> > groups =
+        split_files(files, mopt_shards);
 
-    if (mopt_verbose >= 2)
-        OUT("line: " << line);
+    size_t num = groups.size();
 
-    std::set<std::string> keyset;
+    // create files of the shard databases
+    const char* tmpdir = getenv("TMPDIR");
+    std::string tmpl = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") +
+                       "/sqlplot-shard-XXXXXX";
 
-    if (!mopt_firstline)
+    std::vector<std::string> paths;
+
+    for (size_t s = 0; s < num; ++s)
     {
-        // split line and detect types of each field
-        slist_type slist = split_result_line(line);
+        std::vector<char> pathbuf(tmpl.begin(), tmpl.end());
+        pathbuf.push_back(0);
 
-        size_t col = 0;
-        for (slist_type::iterator si = slist.begin();
-             si != slist.end(); ++si, ++col)
-        {
-            if (si->size() == 0) return true;
-            std::string key, value;
-            split_keyvalue(*si, col, key, value);
-            key = dedup_key(key, keyset);
-            m_fieldset.add_field(key, value);
+        int fd = mkstemp(pathbuf.data());
+        if (fd < 0) {
+            for (size_t i = 0; i < paths.size(); ++i) unlink(paths[i].c_str());
+            OUT_THROW("Error creating shard file " << tmpl << ": " << strerror(errno));
         }
+        close(fd);
 
-        // cache line
-        m_linedata.push_back(line);
-        ++m_count, ++m_total_count;
+        paths.push_back(pathbuf.data());
     }
-    else
+
+    OUT("Importing " << files.size() << " files into " << num << " shards.");
+
+    // import groups of files in parallel, each with its own connection
+    std::vector< boost::shared_ptr<ImportData> > shards(num);
+    std::vector<std::exception_ptr> errors(num);
+    std::vector<std::thread> threads;
+
+    for (size_t s = 0; s < num; ++s)
     {
-        if (m_total_count == 0)
+        threads.emplace_back(
+            [&, s]() {
+                try
+                {
+                    SQLiteDatabase db;
+                    if (!db.initialize(paths[s]))
+                        OUT_THROW("Could not open shard database " << paths[s]);
+
+                    db.bulk_profile(true);
+
+                    boost::shared_ptr<ImportData> shard(new ImportData(false));
+                    shard->m_db = &db;
+                    shard->m_tablename = m_tablename;
+                    shard->mopt_verbose = mopt_verbose;
+                    shard->mopt_firstline = mopt_firstline;
+                    shard->mopt_single_pass = mopt_single_pass;
+                    shard->mopt_all_lines = mopt_all_lines;
+                    shard->mopt_colnums = mopt_colnums;
+                    shard->mopt_empty_okay = mopt_empty_okay;
+                    shard->mopt_spill_limit = mopt_spill_limit / num;
+                    shard->mopt_untyped = true;
+
+                    shard->import_files(groups[s]);
+                    shard->m_db = NULL;
+
+                    shards[s] = shard;
+                }
+                catch (...)
+                {
+                    errors[s] = std::current_exception();
+                }
+            });
+    }
+
+    for (size_t s = 0; s < num; ++s)
+        threads[s].join();
+
+    // number of shard databases attached to the connection
+    size_t attached = 0;
+
+    try
+    {
+        for (size_t s = 0; s < num; ++s)
         {
-            // split line and detect types of each field
-            slist_type slist = split_result_line(line);
+            if (errors[s]) std::rethrow_exception(errors[s]);
+        }
 
-            size_t col = 0;
-            for (slist_type::iterator si = slist.begin();
-                 si != slist.end(); ++si, ++col)
+        // combine field sets of the shards in order, widening column types
+        for (size_t s = 0; s < num; ++s)
+        {
+            for (size_t i = 0; i < shards[s]->m_fieldset.count(); ++i)
             {
-                if (si->size() == 0) return true;
-                std::string key, value;
-                split_keyvalue(*si, col, key, value);
-                key = dedup_key(key, keyset);
-                m_fieldset.add_field(key, value);
+                m_fieldset.add_field(shards[s]->m_fieldset.key(i),
+                                     shards[s]->m_fieldset.type(i));
             }
-
-            // immediately create table from first row
-            if (!create_table()) return false;
         }
 
-        if (insert_line(line)) {
-            ++m_count, ++m_total_count;
+        // databases cannot be attached within a transaction, attach all
+        // shards before copying their rows.
+        for ( ; attached < num; ++attached)
+        {
+            std::string path = replace_all(paths[attached], "'", "''");
+
+            m_db->execute("ATTACH DATABASE '" + path + "' AS sqlplot_shard" +
+                          to_str(attached));
         }
-    }
 
-    return true;
-}
+        m_db->execute("BEGIN");
 
-//! process cached data lines
-void ImportData::process_linedata()
-{
-    if (!create_table()) return;
+        try
+        {
+            create_table();
 
-    for (slist_type::const_iterator line = m_linedata.begin();
-         line != m_linedata.end(); ++line)
+            // copy rows of each shard
+            for (size_t s = 0; s < num; ++s)
+            {
+                const FieldSet& fs = shards[s]->m_fieldset;
+                if (fs.count() == 0) continue;
+
+                std::ostringstream cols;
+                for (size_t i = 0; i < fs.count(); ++i)
+                {
+                    if (i != 0) cols << ',';
+                    cols << m_db->quote_field(fs.key(i));
+                }
+
+                // the shards keep the values as text, which the merged
+                // column types convert like inserting them sequentially.
+                m_db->execute("INSERT INTO " + m_db->quote_field(m_tablename) +
+                              " (" + cols.str() + ") SELECT " + cols.str() +
+                              " FROM sqlplot_shard" + to_str(s) + "." +
+                              m_db->quote_field(m_tablename));
+
+                m_total_count += shards[s]->m_total_count;
+            }
+
+            m_db->execute("COMMIT");
+        }
+        catch (...)
+        {
+            m_total_count = 0;
+            m_db->execute("ROLLBACK");
+            throw;
+        }
+
+        for ( ; attached != 0; --attached)
+            m_db->execute("DETACH DATABASE sqlplot_shard" + to_str(attached - 1));
+    }
+    catch (...)
     {
-        if (insert_line(*line)) {
-            ++m_count, ++m_total_count;
+        // detach the remaining shards, keeping the original error
+        for ( ; attached != 0; --attached)
+        {
+            try {
+                m_db->execute("DETACH DATABASE sqlplot_shard" +
+                              to_str(attached - 1));
+            }
+            catch (std::runtime_error&) { }
         }
+
+        for (size_t s = 0; s < num; ++s) unlink(paths[s].c_str());
+        throw;
     }
+
+    for (size_t s = 0; s < num; ++s) unlink(paths[s].c_str());
 }
 
 //! initializing constructor
-ImportData::ImportData(bool temporary_table)
+ImportData::ImportData(bool temporary_table, bool serve)
     : mopt_verbose(gopt_verbose),
       mopt_firstline(false),
+      mopt_single_pass(false),
       mopt_all_lines(false),
       mopt_noduplicates(false),
       mopt_colnums(false),
       mopt_temporary_table(temporary_table),
       mopt_empty_okay(false),
       mopt_append_data(false),
+      mopt_threads(0),
+      mopt_spill_limit(1024 * 1024 * 1024llu),
+      mopt_incremental(false),
+      mopt_follow(false),
+      mopt_follow_interval(1000),
+      mopt_follow_batch(4 * 1024 * 1024),
+      mopt_serve(serve),
+      mopt_keep_profile(false),
+      mopt_shards(0),
+      mopt_columnar(false),
+      mopt_untyped(false),
+      m_db(NULL),
+      m_insert_cache(16),
+      m_stream_skip(0),
+      m_stream_offset(0),
+      m_stream_binary(false),
+      m_count(0),
       m_total_count(0)
 {
 }
 
+//! stop parser threads
+ImportData::~ImportData()
+{
+    // join the threads, discarding their errors, before the members used by
+    // the writer are destroyed.
+    m_pipeline.reset();
+}
+
 //! define identifiers for command line arguments
 enum { OPT_HELP, OPT_VERBOSE,
-       OPT_FIRSTLINE, OPT_ALL_LINES, OPT_NO_DUPLICATE,
+       OPT_FIRSTLINE, OPT_SINGLE_PASS, OPT_ALL_LINES, OPT_NO_DUPLICATE,
        OPT_COLUMN_NUMBERS, OPT_EMPTY_OKAY,
        OPT_TEMPORARY_TABLE, OPT_PERMANENT_TABLE,
-       OPT_DATABASE, OPT_APPEND_DATA };
+       OPT_DATABASE, OPT_APPEND_DATA, OPT_THREADS, OPT_SPILL_LIMIT,
+       OPT_FINGERPRINTS, OPT_INCREMENTAL, OPT_FOLLOW, OPT_KEEP_PROFILE,
+       OPT_SHARDS, OPT_COLUMNAR };
 
 //! define command line arguments
 static CSimpleOpt::SOption sopt_list[] = {
@@ -480,31 +2197,59 @@ static CSimpleOpt::SOption sopt_list[] = {
     { OPT_HELP,            "-h", SO_NONE },
     { OPT_VERBOSE,         "-v", SO_NONE },
     { OPT_FIRSTLINE,       "-1", SO_NONE },
+    { OPT_SINGLE_PASS,     "-S", SO_NONE },
     { OPT_ALL_LINES,       "-a", SO_NONE },
     { OPT_NO_DUPLICATE,    "-d", SO_NONE },
+    { OPT_FINGERPRINTS,    "-F", SO_REQ_SEP },
     { OPT_COLUMN_NUMBERS,  "-C", SO_NONE },
     { OPT_EMPTY_OKAY,      "-E", SO_NONE },
     { OPT_TEMPORARY_TABLE, "-T", SO_NONE },
     { OPT_PERMANENT_TABLE, "-P", SO_NONE },
     { OPT_DATABASE,        "-D", SO_REQ_SEP },
     { OPT_APPEND_DATA,     "-A", SO_NONE },
+    { OPT_INCREMENTAL,     "-I", SO_NONE },
+    { OPT_FOLLOW,          "-f", SO_NONE },
+    { OPT_FOLLOW,          "--follow", SO_NONE },
+    { OPT_THREADS,         "-j", SO_REQ_SEP },
+    { OPT_SPILL_LIMIT,     "-M", SO_REQ_SEP },
+    { OPT_KEEP_PROFILE,    "-K", SO_NONE },
+    { OPT_SHARDS,          "-W", SO_REQ_SEP },
+    { OPT_COLUMNAR,        "-V", SO_NONE },
     SO_END_OF_OPTIONS
 };
 
 //! print command line usage
 int ImportData::print_usage(const std::string& progname)
 {
-    OUT("Usage: " << progname << " [options] <table-name> [files...]" << std::endl <<
-        std::endl <<
-        "Options: " << std::endl <<
+    if (mopt_serve) {
+        OUT("Usage: " << progname << " [options] <table-name> <socket-path|port>" << std::endl <<
+            std::endl <<
+            "Listens on a Unix domain socket, or a TCP port on localhost, and inserts" << std::endl <<
+            "the RESULT lines sent by any number of clients in batched transactions." << std::endl);
+    }
+    else {
+        OUT("Usage: " << progname << " [options] <table-name> [files...]" << std::endl);
+    }
+
+    OUT("Options: " << std::endl <<
         "  -1       Take field types from first line and process stream." << std::endl <<
+        "  -S       Process stream, adding and widening columns as needed." << std::endl <<
         "  -a       Process all line, regardless of RESULT marker." << std::endl <<
         "  -C       Enumerate unnamed fields with col# instead of using key names." << std::endl <<
         "  -E       Allow empty tables or globs without matching files." << std::endl <<
         "  -d       Eliminate duplicate RESULT lines." << std::endl <<
+        "  -F <fn>  Eliminate duplicates, also of earlier runs recorded in file fn (with -A or -I)." << std::endl <<
         "  -T       Import into TEMPORARY table (for in-file processing)." << std::endl <<
         "  -P       Import into non-TEMPORARY table (reverts the default -T)." << std::endl <<
-        "  -A       Append rows if the table already exists (schema must match)." << std::endl <<
+        "  -A       Append rows if the table already exists (schema must match," << std::endl <<
+        "           unless -S adds and widens its columns)." << std::endl <<
+        "  -I       Incremental: append only lines added to files since the last run." << std::endl <<
+        "  -f, --follow  Keep watching the files and insert new lines in batches." << std::endl <<
+        "  -j <num> Parse lines using num threads, while inserting in order." << std::endl <<
+        "  -M <mib> Spill cached lines to disk beyond mib MiB, may be fractional (default 1024, 0 = never)." << std::endl <<
+        "  -W <num> Import files in num threads into SQLite shards, merged at the end." << std::endl <<
+        "  -V       Keep TEMPORARY table in typed in-memory columns (SQLite only)." << std::endl <<
+        "  -K       Keep the fast bulk loading settings of the database connection." << std::endl <<
         "  -v       Increase verbosity." << std::endl);
 
     return EXIT_FAILURE;
@@ -537,6 +2282,10 @@ int ImportData::main(int argc, char* argv[])
             mopt_firstline = true;
             break;
 
+        case OPT_SINGLE_PASS:
+            mopt_firstline = mopt_single_pass = true;
+            break;
+
         case OPT_ALL_LINES:
             mopt_all_lines = true;
             break;
@@ -549,6 +2298,11 @@ int ImportData::main(int argc, char* argv[])
             mopt_noduplicates = true;
             break;
 
+        case OPT_FINGERPRINTS:
+            mopt_noduplicates = true;
+            mopt_fingerprint_file = args.OptionArg();
+            break;
+
         case OPT_COLUMN_NUMBERS:
             mopt_colnums = true;
             break;
@@ -572,15 +2326,72 @@ int ImportData::main(int argc, char* argv[])
         case OPT_APPEND_DATA:
             mopt_append_data = true;
             break;
+
+        case OPT_INCREMENTAL:
+            mopt_incremental = true;
+            break;
+
+        case OPT_FOLLOW:
+            // insert lines directly and track the offsets of files
+            mopt_follow = mopt_incremental = true;
+            mopt_firstline = mopt_single_pass = true;
+            break;
+
+        case OPT_THREADS:
+            if (!from_str(args.OptionArg(), mopt_threads)) {
+                OUT(argv[0] << ": invalid thread number '" << args.OptionArg() << "'");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case OPT_SHARDS:
+            if (!from_str(args.OptionArg(), mopt_shards)) {
+                OUT(argv[0] << ": invalid shard number '" << args.OptionArg() << "'");
+                return EXIT_FAILURE;
+            }
+            break;
+
+        case OPT_COLUMNAR:
+            mopt_columnar = true;
+            break;
+
+        case OPT_KEEP_PROFILE:
+            mopt_keep_profile = true;
+            break;
+
+        case OPT_SPILL_LIMIT:
+        {
+            // fractions of a MiB are allowed, reject limits overflowing size_t
+            double mib;
+            if (!from_str(args.OptionArg(), mib) || !(mib >= 0) ||
+                mib >= (double)SIZE_MAX / (1024 * 1024)) {
+                OUT(argv[0] << ": invalid memory limit '" << args.OptionArg() << "'");
+                return EXIT_FAILURE;
+            }
+            mopt_spill_limit = (size_t)(mib * 1024 * 1024);
+            break;
+        }
         }
     }
 
     // no table name given
-    if (args.FileCount() == 0) {
+    if (args.FileCount() == 0 || (mopt_serve && args.FileCount() != 2)) {
         print_usage(argv[0]);
 	return EXIT_FAILURE;
     }
 
+    if (mopt_serve)
+    {
+        // insert lines directly, adding and widening columns as needed
+        mopt_firstline = mopt_single_pass = true;
+
+        if (mopt_incremental || mopt_follow || mopt_shards > 1 || mopt_columnar)
+        {
+            OUT(argv[0] << ": options -I, -f, -W and -V do not apply to sockets.");
+            return EXIT_FAILURE;
+        }
+    }
+
     m_tablename = args.File(0);
 
     // maybe connect to database
@@ -592,17 +2403,30 @@ int ImportData::main(int argc, char* argv[])
         opt_dbconnect = true;
     }
 
-    // begin transaction
-    g_db->execute("BEGIN");
+    m_db = g_db;
 
-    // process file commandline arguments
-    if (args.FileCount())
+    // load fingerprints of lines imported earlier
+    if (!mopt_fingerprint_file.empty())
     {
-        // glob to expand wild cards in arguments
+        // a replaced table drops the rows recorded earlier
+        if (!mopt_append_data && !mopt_incremental)
+            FingerprintSet::remove(mopt_fingerprint_file);
+
+        size_t count = m_fingerprints.load(mopt_fingerprint_file);
+        if (mopt_verbose >= 1)
+            OUT("Loaded " << count << " fingerprints from " << mopt_fingerprint_file);
+    }
 
-        int gflags = SG_GLOB_TILDE | SG_GLOB_ONLYFILE;
-        if (mopt_empty_okay) gflags |= SG_GLOB_NOCHECK;
+    // trade durability for speed while loading derived data, the settings
+    // are restored also if the import fails.
+    SqlBulkProfile profile(*m_db);
+    if (mopt_keep_profile)
+        profile.keep();
 
+    // expand wild cards in file arguments
+    std::vector<std::string> files;
+    if (!mopt_serve)
+    {
         CSimpleGlob glob(SG_GLOB_NODOT | SG_GLOB_NOCHECK);
         if (SG_SUCCESS != glob.Add(args.FileCount() - 1, args.Files() + 1)) {
             OUT_THROW("Error while globbing files");
@@ -610,26 +2434,57 @@ int ImportData::main(int argc, char* argv[])
         }
 
         for (int fi = 0; fi < glob.FileCount(); ++fi)
-            process_file(glob.File(fi));
+            files.push_back(glob.File(fi));
     }
-    else
+
+    if (mopt_shards > 1 && m_db->type() != SqlDatabase::DB_SQLITE)
     {
-        // no file arguments -> process stdin
-        OUT("Reading data from stdin ...");
-        process_stream(stdin, "<stdin>");
+        OUT("Sharded import requires an SQLite database, importing in one piece.");
+        mopt_shards = 0;
     }
 
-    // process cached data lines
-    if (!mopt_firstline)
+    // in-memory columns are read-only and filled from cached lines
+    if (mopt_columnar && (!mopt_temporary_table || mopt_append_data ||
+                          mopt_incremental || mopt_firstline || mopt_shards > 1))
     {
-        m_count = m_total_count = 0;
-        process_linedata();
+        OUT("In-memory columns require a new TEMPORARY table and cached lines, "
+            "ignoring -V.");
+        mopt_columnar = false;
     }
 
-    // finish transaction
-    g_db->execute("COMMIT");
+    if (mopt_serve)
+    {
+        // nothing to import before serving
+    }
+    else if (mopt_shards > 1 && files.size() > 1)
+        import_sharded(files);
+    else
+        import_files(files);
+
+    // remember imported lines only after they were committed
+    if (!mopt_fingerprint_file.empty())
+    {
+        FingerprintSet::append(mopt_fingerprint_file, m_new_fingerprints);
+        m_new_fingerprints.clear();
+    }
+
+    if (!mopt_serve)
+        OUT("Imported in total " << m_total_count << " rows of data containing " << m_fieldset.count() << " fields each.");
+
+    // restore settings, also to let others read while following files
+    profile.restore();
+
+    // keep watching the files for new lines
+    if (mopt_follow)
+    {
+        std::vector<std::string> patterns(args.Files() + 1,
+                                          args.Files() + args.FileCount());
+        follow(patterns);
+    }
 
-    OUT("Imported in total " << m_total_count << " rows of data containing " << m_fieldset.count() << " fields each.");
+    // receive lines from clients of the socket
+    if (mopt_serve)
+        serve(args.File(1));
 
     if (opt_dbconnect)
         g_db_free();
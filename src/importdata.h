@@ -24,10 +24,28 @@
 #ifndef IMPORTDATA_HEADER
 #define IMPORTDATA_HEADER
 
+#include "binresult.h"
+#include "decompress.h"
 #include "fieldset.h"
+#include "fingerprint.h"
+#include "keytable.h"
+#include "lrucache.h"
+#include "sql.h"
+#include "stringref.h"
 
+#include <map>
 #include <set>
 
+#include <stdint.h>
+
+#include <boost/scoped_ptr.hpp>
+
+template <typename Chunk>
+class OrderedPipeline;
+
+class MappedFile;
+class SpillFile;
+
 //! Encapsules one sp-importdata processes, which can also be run from other
 //! sqlplot processors.
 class ImportData
@@ -40,6 +58,9 @@ protected:
     //! take field types from first line and process stream
     bool mopt_firstline;
 
+    //! process stream, adding and widening columns as new data arrives
+    bool mopt_single_pass;
+
     //! parse all lines as key=value lines, ignoring RESULT flags
     bool mopt_all_lines;
 
@@ -58,20 +79,109 @@ protected:
     //! append rows to table instead of clearing all data
     bool mopt_append_data;
 
+    //! number of parser threads, zero to parse lines in the reader
+    unsigned int mopt_threads;
+
+    //! memory size of cached lines after which they are spilled to disk
+    size_t mopt_spill_limit;
+
+    //! append only data added to files since the last run
+    bool mopt_incremental;
+
+    //! keep watching the files for appended lines
+    bool mopt_follow;
+
+    //! milliseconds to collect appended lines before committing them
+    unsigned int mopt_follow_interval;
+
+    //! number of appended bytes after which they are committed immediately
+    uint64_t mopt_follow_batch;
+
+    //! run as serve-import: receive lines from clients of a socket
+    bool mopt_serve;
+
+    //! keep bulk loading settings of the database connection after import
+    bool mopt_keep_profile;
+
+    //! number of threads importing files into separate SQLite shards
+    unsigned int mopt_shards;
+
+    //! keep the table in typed in-memory columns
+    bool mopt_columnar;
+
+    //! create columns without type and insert values as text, for shards
+    //! whose column types are applied when merging them.
+    bool mopt_untyped;
+
+    //! database connection to import into, g_db or the one of a shard
+    SqlDatabase* m_db;
+
     //! table imported
     std::string m_tablename;
 
     //! field set of all imported data
     FieldSet m_fieldset;
 
-    //! type of array of all data key=value lines
-    typedef std::vector<std::string> slist_type;
+    //! type of array of key ids
+    typedef std::vector<KeyTable::id_type> klist_type;
+
+    //! type of array of values or lines referencing the input
+    typedef std::vector<StringRef> vlist_type;
 
     //! array of all data key=value lines
-    slist_type m_linedata;
+    vlist_type m_linedata;
+
+    //! storage of cached lines which were not read from mapped files
+    StringArena m_linearena;
+
+    //! mapped input files, kept until the cached lines are processed
+    std::vector< boost::shared_ptr<MappedFile> > m_mappings;
+
+    //! split lines cached on disk after the memory limit was reached
+    boost::scoped_ptr<SpillFile> m_spill;
 
-    //! sorted set of all data lines, for mopt_noduplicates
-    std::set<std::string> m_lineset;
+    //! file of fingerprints of lines imported by earlier runs
+    std::string mopt_fingerprint_file;
+
+    //! fingerprints of all data lines, for mopt_noduplicates
+    FingerprintSet m_fingerprints;
+
+    //! fingerprints of new lines, appended to mopt_fingerprint_file
+    std::vector<Fingerprint> m_new_fingerprints;
+
+    //! LRU cache of prepared INSERT statements keyed by column signature
+    LruCache<std::string, SqlStatement> m_insert_cache;
+
+    //! identity and imported part of a file, for mopt_incremental
+    struct FileState
+    {
+        //! inode, size and modification time when last read
+        uint64_t inode, size, mtime;
+
+        //! offset after the last imported complete line
+        uint64_t offset;
+    };
+
+    //! type of map of file names to their state
+    typedef std::map<std::string, FileState> filestate_type;
+
+    //! state of files imported by earlier runs
+    filestate_type m_filestate;
+
+    //! number of bytes to skip at the beginning of the current file
+    uint64_t m_stream_skip;
+
+    //! offset after the last complete line read from the current file
+    uint64_t m_stream_offset;
+
+    //! current file starts with the magic of binary RESULT records
+    bool m_stream_binary;
+
+    //! decoder of binary RESULT records, keeps the key dictionary
+    BinResultDecoder m_bindecoder;
+
+    //! incomplete binary record at the end of the last block
+    std::string m_binpending;
 
     //! number of RESULT lines counted in current file
     size_t m_count;
@@ -79,32 +189,204 @@ protected:
     //! number of RESULT lines counted over all files
     size_t m_total_count;
 
+    //! RESULT line split into deduplicated keys, values and detected types
+    struct ParsedLine
+    {
+        //! original line
+        StringRef line;
+
+        //! line references a mapped file, which outlives the import
+        bool stable;
+
+        //! deduplicated keys
+        klist_type keys;
+
+        //! values referencing the line
+        vlist_type values;
+
+        //! detected type of each value
+        std::vector<FieldSet::fieldtype> types;
+
+        //! parameter types of decoded binary rows, empty for text lines
+        SqlStatementImpl::ptypes_type ptypes;
+    };
+
+    //! chunk of lines passed through the parser threads
+    struct LineChunk
+    {
+        //! RESULT lines read, parsed by the worker threads
+        std::vector<ParsedLine> lines;
+
+        //! storage of lines which are not stable
+        StringArena arena;
+
+        //! name of the input which ended after these lines, if any
+        std::string eof_fname;
+    };
+
+    //! type of parser pipeline
+    typedef OrderedPipeline<LineChunk> pipeline_type;
+
+    //! parser pipeline, if mopt_threads is set
+    boost::scoped_ptr<pipeline_type> m_pipeline;
+
+    //! chunk currently filled by the reader
+    LineChunk m_chunk;
+
+    //! split a RESULT line into keys, values and types (thread-safe)
+    void parse_line(ParsedLine& pl) const;
+
+    //! parse all lines of a chunk, run by the worker threads
+    void parse_chunk(LineChunk& chunk) const;
+
+    //! process lines of a parsed chunk, run by the writer thread
+    void write_chunk(LineChunk& chunk);
+
+    //! push the reader's current chunk into the pipeline
+    void push_chunk();
+
 public:
-    //! initializing constructor
-    ImportData(bool temporary_table = false);
+    //! initializing constructor, serve selects serve-import which receives
+    //! lines from clients of a socket instead of reading files.
+    ImportData(bool temporary_table = false, bool serve = false);
+
+    //! stop parser threads
+    ~ImportData();
 
     //! returns true if the give table exists.
     static bool exist_table(const std::string& table);
 
-    //! CREATE TABLE for the accumulated data set
-    bool create_table() const;
+    //! CREATE TABLE for the accumulated data set, or continue an existing
+    //! table when appending, adapting it to the data only with -S.
+    bool create_table();
+
+    //! load the columns of the existing table into the field set, then add
+    //! or widen columns for the fields found in the data so far.
+    void adopt_table();
+
+    //! ALTER TABLE to add the new field col of the field set
+    void add_column(size_t col);
+
+    //! change column col to the wider type of the field set
+    void widen_column(size_t col);
+
+    //! add or widen the column of a field, returns true if the table changed
+    bool widen_field(KeyTable::id_type id, FieldSet::fieldtype type);
+
+    //! add or widen columns of the table for the fields of a parsed line
+    void widen_schema(const ParsedLine& pl);
+
+    //! return (cached) prepared INSERT statement for the given columns,
+    //! binding native values of decoded binary rows as given by ptypes.
+    SqlStatement& insert_statement(
+        const klist_type& keys,
+        const SqlStatementImpl::ptypes_type& ptypes);
+
+    //! check for and remember duplicate lines if requested
+    bool is_duplicate(const StringRef& line);
+
+    //! insert a line with given keys and values into the database table
+    bool insert_line(const StringRef& line,
+                     const klist_type& keys, const vlist_type& values,
+                     const SqlStatementImpl::ptypes_type& ptypes);
 
     //! insert a line into the database table
-    bool insert_line(const std::string& line);
+    bool insert_line(const StringRef& line);
+
+    //! append a line to a bulk load of all fields in the field set
+    bool bulk_line(SqlBulkLoadImpl& bulk, const StringRef& line);
+
+    //! append a line with given keys and values to a bulk load of all fields
+    //! in the field set
+    bool bulk_line(SqlBulkLoadImpl& bulk, const StringRef& line,
+                   const klist_type& keys, const vlist_type& values,
+                   const SqlStatementImpl::ptypes_type& ptypes);
+
+    //! process a parsed line: cache lines or insert directly.
+    bool process_parsed(ParsedLine& pl);
 
-    //! process a line: cache lines or insert directly.
-    bool process_line(const std::string& line);
+    //! process a line: cache lines or insert directly. Stable lines reference
+    //! a mapped file and are cached without copying.
+    bool process_line(const StringRef& line, bool stable = false);
+
+    //! parse a RESULT line or decoded binary row, or queue it for the parser
+    //! threads.
+    bool dispatch_line(const StringRef& line, bool stable);
+
+    //! output number of rows read from an input stream
+    void finish_stream(const std::string& fname);
+
+    //! mark end of an input stream, maybe after queued lines are processed
+    void end_stream(const char* fname);
+
+    //! split a block of data into lines, the unfinished last line is kept
+    bool process_block(std::string& line, const char* data, size_t size);
+
+    //! split a block of data into lines without tracking the file offset
+    bool split_block(std::string& line, const char* data, size_t size);
+
+    //! decode the complete binary RESULT records in data, used is set to
+    //! their number of bytes.
+    bool process_binary(const char* data, size_t size, size_t& used);
+
+    //! decode a block of binary RESULT records, the incomplete last record
+    //! is kept.
+    bool process_binary_block(const char* data, size_t size);
 
     //! process an input stream and split into lines
     void process_stream(FILE* in, const char* fname);
     void process_stream(std::istream& in, const char* fname);
+    void process_stream(DecompressImpl& in, const char* fname);
+
+    //! process a mapped file and split into lines
+    void process_mapped(const boost::shared_ptr<MappedFile>& file,
+                        const char* fname);
+
+    //! process a file, compressed files may already be opened for reading.
+    void process_file(const std::string& fname, Decompress in = Decompress());
+
+    //! read a file, decompressing it if necessary.
+    void read_file(const std::string& fname, Decompress in);
 
-    //! process a line: cache lines or insert directly.
-    void process_file(const std::string& fname);
+    //! return the quoted name of the state table for the target table
+    std::string filestate_name() const;
+
+    //! return the first of the files which was replaced, truncated or
+    //! rewritten since its lines were imported, or an empty string.
+    std::string rewritten_file(const std::vector<std::string>& files) const;
+
+    //! load state of incremental imports of the table
+    void load_file_state();
+
+    //! save state of incremental imports of the table
+    void save_file_state();
+
+    //! sum of bytes appended to files since they were last read
+    uint64_t pending_bytes(const std::vector<std::string>& files) const;
+
+    //! watch files matching the patterns and import appended lines in
+    //! batched transactions until interrupted.
+    void follow(const std::vector<std::string>& patterns);
+
+    //! listen on a Unix domain socket or localhost TCP port and import the
+    //! lines streamed by clients in batched transactions until interrupted.
+    void serve(const std::string& address);
+
+    //! replace the table by one kept in typed in-memory columns
+    SqlBulkLoad create_columnar();
 
     //! process cached data lines
     void process_linedata();
 
+    //! read files and insert their lines into the table
+    void read_files(const std::vector<std::string>& files);
+
+    //! import files into the table in one transaction
+    void import_files(const std::vector<std::string>& files);
+
+    //! import files in parallel into SQLite shards and merge them
+    void import_sharded(const std::vector<std::string>& files);
+
     //! print command line usage
     int print_usage(const std::string& progname);
 
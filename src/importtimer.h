@@ -0,0 +1,90 @@
+/******************************************************************************
+ * src/importtimer.h
+ *
+ * Accumulated wall time of the phases of IMPORT-DATA, measured for the import
+ * benchmark.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef IMPORTTIMER_HEADER
+#define IMPORTTIMER_HEADER
+
+#include <atomic>
+#include <chrono>
+
+#include <stdint.h>
+
+/*!
+ * Timers of the import phases. They are disabled by default and then cost one
+ * branch per measured scope. With parser threads, the parse and detect times
+ * sum the time of all threads.
+ */
+class ImportTimer
+{
+public:
+    //! measured phases, reading is the remainder of the total time
+    enum phase { PARSE, DETECT, INSERT, NUM_PHASES };
+
+    //! measure phases
+    static bool enabled;
+
+    //! accumulated nanoseconds of each phase
+    static std::atomic<uint64_t> nanos[NUM_PHASES];
+
+    //! clear all phase times
+    static void reset()
+    {
+        for (int p = 0; p < NUM_PHASES; ++p) nanos[p] = 0;
+    }
+
+    //! return accumulated seconds of a phase
+    static double seconds(phase p)
+    {
+        return nanos[p] / 1e9;
+    }
+
+    //! add the lifetime of the scope to a phase, if timers are enabled
+    class Scope
+    {
+    protected:
+        //! phase to account to
+        phase m_phase;
+
+        //! start time, if enabled
+        std::chrono::steady_clock::time_point m_start;
+
+        //! timers were enabled at the start
+        bool m_enabled;
+
+    public:
+        explicit Scope(phase p)
+            : m_phase(p), m_enabled(enabled)
+        {
+            if (m_enabled) m_start = std::chrono::steady_clock::now();
+        }
+
+        ~Scope()
+        {
+            if (!m_enabled) return;
+            nanos[m_phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start).count();
+        }
+    };
+};
+
+#endif // IMPORTTIMER_HEADER
@@ -0,0 +1,177 @@
+/******************************************************************************
+ * src/keytable.cpp
+ *
+ * Process-wide symbol table of field keys, which maps each distinct key name
+ * to a small integer id.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "keytable.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//! shared part of the key table
+struct KeyTableShared
+{
+    //! lock for all members
+    std::mutex mutex;
+
+    //! key names by id, a deque keeps their addresses stable
+    std::deque<std::string> names;
+
+    //! map of key names to ids
+    std::unordered_map<std::string, KeyTable::id_type> index;
+};
+
+//! return the shared key table
+static KeyTableShared& shared_table()
+{
+    static KeyTableShared table;
+    return table;
+}
+
+//! FNV-1a hash of a key
+static inline uint64_t hash_key(const StringRef& key)
+{
+    uint64_t h = 0xcbf29ce484222325LLU;
+    for (const char* p = key.begin(); p != key.end(); ++p)
+        h = (h ^ (uint8_t)*p) * 0x100000001b3LLU;
+    return h;
+}
+
+/*!
+ * Cache of a thread mapping keys to ids without locking, using open
+ * addressing with linear probing. Names point into the shared table.
+ */
+class KeyCache
+{
+protected:
+    //! slot of the hash table, unused if name is NULL
+    struct Slot
+    {
+        uint64_t hash;
+        const std::string* name;
+        KeyTable::id_type id;
+    };
+
+    //! flat table, size is a power of two
+    std::vector<Slot> m_table;
+
+    //! number of used slots
+    size_t m_size;
+
+    //! insert into table without growing
+    void insert_slot(const Slot& s)
+    {
+        size_t mask = m_table.size() - 1;
+        size_t i = s.hash & mask;
+        while (m_table[i].name) i = (i + 1) & mask;
+        m_table[i] = s;
+    }
+
+public:
+    //! construct empty cache
+    KeyCache()
+        : m_table(64), m_size(0)
+    {
+    }
+
+    //! look up key, returns false if it is not cached
+    bool find(const StringRef& key, uint64_t hash, KeyTable::id_type& id) const
+    {
+        size_t mask = m_table.size() - 1;
+
+        for (size_t i = hash & mask; m_table[i].name; i = (i + 1) & mask)
+        {
+            if (m_table[i].hash == hash && StringRef(*m_table[i].name) == key) {
+                id = m_table[i].id;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! add key to cache, keeping the load factor below one half
+    void insert(uint64_t hash, const std::string* name, KeyTable::id_type id)
+    {
+        if (2 * (m_size + 1) > m_table.size())
+        {
+            std::vector<Slot> old(2 * m_table.size());
+            old.swap(m_table);
+
+            for (size_t i = 0; i < old.size(); ++i)
+            {
+                if (old[i].name) insert_slot(old[i]);
+            }
+        }
+
+        Slot s = { hash, name, id };
+        insert_slot(s);
+        ++m_size;
+    }
+};
+
+//! return id of a key, adding it if necessary
+KeyTable::id_type KeyTable::intern(const StringRef& key)
+{
+    static thread_local KeyCache cache;
+
+    uint64_t hash = hash_key(key);
+
+    id_type id;
+    if (cache.find(key, hash, id)) return id;
+
+    KeyTableShared& table = shared_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    std::string name = key.str();
+
+    std::unordered_map<std::string, id_type>::const_iterator it =
+        table.index.find(name);
+
+    if (it != table.index.end()) {
+        id = it->second;
+    }
+    else {
+        id = table.names.size();
+        table.names.push_back(name);
+        table.index.insert(std::make_pair(name, id));
+    }
+
+    cache.insert(hash, &table.names[id], id);
+    return id;
+}
+
+//! return name of a key id. The reference stays valid.
+const std::string& KeyTable::name(id_type id)
+{
+    KeyTableShared& table = shared_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.names[id];
+}
+
+//! number of interned keys
+size_t KeyTable::size()
+{
+    KeyTableShared& table = shared_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return table.names.size();
+}
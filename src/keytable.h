@@ -0,0 +1,61 @@
+/******************************************************************************
+ * src/keytable.h
+ *
+ * Process-wide symbol table of field keys, which maps each distinct key name
+ * to a small integer id.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef KEYTABLE_HEADER
+#define KEYTABLE_HEADER
+
+#include <string>
+
+#include <stdint.h>
+
+#include "stringref.h"
+
+/*!
+ * Interned key names. Ids are assigned consecutively from zero and stay valid
+ * for the lifetime of the process, hence they can index plain arrays. All
+ * functions are thread-safe: each thread looks up keys in its own cache and
+ * only takes a lock for keys it has not seen before.
+ */
+class KeyTable
+{
+public:
+    //! type of key ids
+    typedef uint32_t id_type;
+
+    //! return id of a key, adding it if necessary
+    static id_type intern(const StringRef& key);
+
+    //! return id of a key, adding it if necessary
+    static id_type intern(const std::string& key)
+    {
+        return intern(StringRef(key));
+    }
+
+    //! return name of a key id. The reference stays valid.
+    static const std::string& name(id_type id);
+
+    //! number of interned keys
+    static size_t size();
+};
+
+#endif // KEYTABLE_HEADER
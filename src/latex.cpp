@@ -42,6 +42,23 @@
 #include "importdata.h"
 #include "reformat.h"
 
+//! Output column col of the current row with reduced precision, like
+//! str_reduce(), but without copying the cell.
+static inline void
+put_reduced(std::ostream& os, const SqlQuery& sql, unsigned int col)
+{
+    StringRef view = sql->view(col);
+
+    double d;
+    if (view.size() <= 8 || !sql->as_double(col, d)) {
+        os << view;
+        return;
+    }
+
+    char buffer[32];
+    os.write(buffer, snprintf(buffer, sizeof(buffer), "%.6g", d));
+}
+
 class SpLatex
 {
 public:
@@ -163,7 +180,7 @@ void SpLatex::plot(size_t ln, size_t indent, const std::string& cmdline)
         for (unsigned int col = 0; col < sql->num_cols(); ++col)
         {
             if (col != 0) oss << ',';
-            oss << str_reduce(sql->text(col));
+            put_reduced(oss, sql, col);
         }
         oss << ')';
     }
@@ -310,7 +327,7 @@ void SpLatex::multiplot(size_t ln, size_t indent, const std::string& cmdline)
     std::vector<std::string> attrlist;
 
     {
-        std::vector<std::string> lastgroup;
+        std::vector<std::string> lastgroup, rowgroup(groupcols.size());
         std::ostringstream coord;
 
         while (sql->step())
@@ -327,10 +344,10 @@ void SpLatex::multiplot(size_t ln, size_t indent, const std::string& cmdline)
             }
 
             // collect groupfields for this row
-            std::vector<std::string> rowgroup (groupcols.size());
-
-            for (size_t i = 0; i < groupcols.size(); ++i)
-                rowgroup[i] = sql->text(groupcols[i]);
+            for (size_t i = 0; i < groupcols.size(); ++i) {
+                StringRef group = sql->view(groupcols[i]);
+                rowgroup[i].assign(group.data(), group.size());
+            }
 
             if (row == 0 || lastgroup != rowgroup)
             {
@@ -346,7 +363,7 @@ void SpLatex::multiplot(size_t ln, size_t indent, const std::string& cmdline)
                     legendlist.push_back(escape_latex(sql->text(col_title)));
                 }
                 else if (ptitle_mark) {
-                    legendlist.push_back(sql->text(col_title));
+                    legendlist.push_back(sql->view(col_title).str());
                 }
                 else {
                     // store group's legend string
@@ -360,18 +377,24 @@ void SpLatex::multiplot(size_t ln, size_t indent, const std::string& cmdline)
                 }
 
                 if (attr_mark) {
-                    attrlist.push_back(sql->text(col_attr));
+                    attrlist.push_back(sql->view(col_attr).str());
                 }
             }
 
             // group fields match with last row -> append coordinates.
-            coord << " (" << str_reduce(sql->text(col_x))
-                  <<  ',' << str_reduce(sql->text(col_y))
-                  <<  ')';
+            coord << " (";
+            put_reduced(coord, sql, col_x);
+            coord << ',';
+            put_reduced(coord, sql, col_y);
+            coord << ')';
             if (xerr || yerr) {
-                coord << " +- (" << (xerr ? str_reduce(sql->text(col_xerr)) : "0")
-                      << ',' << (yerr ? str_reduce(sql->text(col_yerr)) : "0")
-                      << ')';
+                coord << " +- (";
+                if (xerr) put_reduced(coord, sql, col_xerr);
+                else coord << '0';
+                coord << ',';
+                if (yerr) put_reduced(coord, sql, col_yerr);
+                else coord << '0';
+                coord << ')';
             }
         }
 
@@ -504,17 +527,17 @@ void SpLatex::tabular(
     // prepare reformatting
     reformat.prepare(sql);
 
-    // calculate width of columns data
+    // format cells once and calculate width of columns data
     std::vector<size_t> cwidth(sql->num_cols(), 0);
+    std::vector<std::string> cells(sql->num_rows() * sql->num_cols());
 
     for (unsigned int i = 0; i < sql->num_rows(); ++i)
     {
         for (unsigned int j = 0; j < sql->num_cols(); ++j)
         {
-            cwidth[j] = std::max(
-                cwidth[j],
-                reformat.format(i,j, sql->text(i,j)).size()
-                );
+            std::string& cell = cells[i * sql->num_cols() + j];
+            cell = reformat.format(i, j, sql);
+            cwidth[j] = std::max(cwidth[j], cell.size());
         }
     }
 
@@ -527,7 +550,7 @@ void SpLatex::tabular(
         {
             if (j != 0) out << separator;
             out << std::setw(cwidth[j])
-                << reformat.format(i, j, sql->text(i,j));
+                << cells[i * sql->num_cols() + j];
         }
         out << endline;
         tlines.push_back(out.str());
@@ -596,7 +619,7 @@ void SpLatex::defmacro(size_t ln, size_t indent, const std::string& cmdline)
             oss << "\\def\\"
                 << str_reduce(sql->col_name(col))
                 << "{"
-                << reformat.format(0, col, sql->text(0, col))
+                << reformat.format(0, col, sql)
                 << "}";
         }
     }
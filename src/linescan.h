@@ -0,0 +1,188 @@
+/******************************************************************************
+ * src/linescan.h
+ *
+ * Vectorized scanner splitting RESULT lines into key=value fields.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef LINESCAN_HEADER
+#define LINESCAN_HEADER
+
+#include <cstring>
+#include <vector>
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*!
+ * Splits a line into fields separated by TABs, or by spaces if the line
+ * contains no TAB, and finds the first equal sign in each field. All three
+ * characters are located in a single pass using SSE2 or AVX2 compares, which
+ * yields a short list of interesting positions. The fields are then built
+ * from these positions only. The result is a compact table of offsets.
+ */
+class LineScanner
+{
+public:
+    //! marks fields without equal sign
+    static const uint32_t npos = 0xFFFFFFFF;
+
+    //! offsets of one field, relative to the line
+    struct Field
+    {
+        //! first character of the field
+        uint32_t begin;
+
+        //! position of the first equal sign or npos
+        uint32_t eq;
+
+        //! end of the field
+        uint32_t end;
+    };
+
+protected:
+    //! positions of TABs, spaces and equal signs
+    std::vector<uint32_t> m_marks;
+
+    //! fields found in the last line
+    std::vector<Field> m_fields;
+
+    //! true if the last line contains a TAB
+    bool m_has_tab;
+
+    //! classify one character in the scalar fallback and tail loops
+    void scan_char(const char* line, size_t i)
+    {
+        char c = line[i];
+        if (c == '\t' || c == ' ' || c == '=') {
+            m_marks.push_back(i);
+            if (c == '\t') m_has_tab = true;
+        }
+    }
+
+    //! append positions of set bits in mask, offset by base
+    void push_mask(uint32_t mask, size_t base)
+    {
+        while (mask != 0) {
+            m_marks.push_back(base + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    //! find all TABs, spaces and equal signs in the line
+    void scan_marks(const char* line, size_t size)
+    {
+        m_marks.clear();
+        m_has_tab = false;
+
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        const __m256i vtab = _mm256_set1_epi8('\t');
+        const __m256i vspace = _mm256_set1_epi8(' ');
+        const __m256i veq = _mm256_set1_epi8('=');
+
+        for ( ; i + 32 <= size; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(line + i));
+
+            uint32_t tab = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vtab));
+            uint32_t other = _mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, vspace),
+                                _mm256_cmpeq_epi8(v, veq)));
+
+            if (tab) m_has_tab = true;
+            push_mask(tab | other, i);
+        }
+#elif defined(__SSE2__)
+        const __m128i vtab = _mm_set1_epi8('\t');
+        const __m128i vspace = _mm_set1_epi8(' ');
+        const __m128i veq = _mm_set1_epi8('=');
+
+        for ( ; i + 16 <= size; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(line + i));
+
+            uint32_t tab = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vtab));
+            uint32_t other = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(v, vspace),
+                             _mm_cmpeq_epi8(v, veq)));
+
+            if (tab) m_has_tab = true;
+            push_mask(tab | other, i);
+        }
+#endif
+        for ( ; i < size; ++i)
+            scan_char(line, i);
+    }
+
+public:
+    //! construct empty scanner
+    LineScanner()
+        : m_has_tab(false)
+    {
+    }
+
+    //! split line[pos,size) into non-empty fields, the separator is chosen
+    //! by looking at the whole line. Returns the field table, which is valid
+    //! until the next call.
+    const std::vector<Field>& scan(const char* line, size_t size, size_t pos)
+    {
+        scan_marks(line, size);
+
+        char sep = m_has_tab ? '\t' : ' ';
+
+        m_fields.clear();
+
+        Field f = { (uint32_t)pos, npos, 0 };
+
+        for (size_t m = 0; m < m_marks.size(); ++m)
+        {
+            uint32_t i = m_marks[m];
+            if (i < pos) continue;
+
+            if (line[i] == sep)
+            {
+                if (i != f.begin) {
+                    f.end = i;
+                    m_fields.push_back(f);
+                }
+                f.begin = i + 1;
+                f.eq = npos;
+            }
+            else if (line[i] == '=' && f.eq == npos)
+            {
+                f.eq = i;
+            }
+        }
+
+        if (f.begin != size) {
+            f.end = size;
+            m_fields.push_back(f);
+        }
+
+        return m_fields;
+    }
+};
+
+#endif // LINESCAN_HEADER
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * src/lrucache.h
+ *
+ * Small least-recently-used cache template, used to keep a bounded number of
+ * prepared SQL statements alive.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef LRUCACHE_HEADER
+#define LRUCACHE_HEADER
+
+#include <cassert>
+#include <list>
+#include <map>
+#include <utility>
+
+//! Map of at most capacity items, which evicts the least recently used entry
+//! when full.
+template <typename Key, typename Value>
+class LruCache
+{
+protected:
+    //! type of (key,value) pairs in the usage list
+    typedef std::pair<Key, Value> pair_type;
+
+    //! list of entries, most recently used at the front
+    typedef std::list<pair_type> list_type;
+
+    //! index into usage list
+    typedef std::map<Key, typename list_type::iterator> map_type;
+
+    //! maximum number of entries
+    size_t m_capacity;
+
+    //! list of entries, most recently used at the front
+    list_type m_list;
+
+    //! index into usage list
+    map_type m_map;
+
+public:
+    //! construct empty cache holding at most capacity items
+    explicit LruCache(size_t capacity)
+        : m_capacity(capacity)
+    {
+        assert(m_capacity > 0);
+    }
+
+    //! number of cached items
+    size_t size() const
+    {
+        return m_list.size();
+    }
+
+    //! return pointer to cached value and mark it as most recently used, or
+    //! NULL if the key is not cached.
+    Value* find(const Key& key)
+    {
+        typename map_type::iterator it = m_map.find(key);
+        if (it == m_map.end()) return NULL;
+
+        // move entry to front of usage list
+        m_list.splice(m_list.begin(), m_list, it->second);
+        return &it->second->second;
+    }
+
+    //! insert a new value for key, which must not be cached yet, and evict
+    //! the least recently used entry if the cache is full.
+    Value& insert(const Key& key, const Value& value)
+    {
+        assert(m_map.find(key) == m_map.end());
+
+        if (m_list.size() >= m_capacity)
+        {
+            m_map.erase(m_list.back().first);
+            m_list.pop_back();
+        }
+
+        m_list.push_front(pair_type(key, value));
+        m_map[key] = m_list.begin();
+
+        return m_list.front().second;
+    }
+
+    //! remove the entry of key, if it is cached
+    void erase(const Key& key)
+    {
+        typename map_type::iterator it = m_map.find(key);
+        if (it == m_map.end()) return;
+
+        m_list.erase(it->second);
+        m_map.erase(it);
+    }
+
+    //! remove all cached items
+    void clear()
+    {
+        m_map.clear();
+        m_list.clear();
+    }
+};
+
+#endif // LRUCACHE_HEADER
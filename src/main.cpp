@@ -114,7 +114,8 @@ sp_process_usage(const std::string& progname)
     OUT("Usage: " << progname << " [options] [files...]" << std::endl <<
         std::endl <<
         "Options: " << std::endl <<
-        " import      Call IMPORT-DATA subprogram to load SQL tables." << std::endl <<
+        " import        Call IMPORT-DATA subprogram to load SQL tables." << std::endl <<
+        " serve-import  Insert RESULT lines received on a socket into a table." << std::endl <<
         "  -v         Increase verbosity." << std::endl <<
         "  -f <type>  Force input file type = latex or gnuplot." << std::endl <<
         "  -o <file>  Output all processed files to this stream." << std::endl <<
@@ -302,6 +303,10 @@ int main(int argc, char* argv[])
         {
             return ImportData().main(argc-1, argv+1);
         }
+        else if (argc >= 2 && strcmp(argv[1], "serve-import") == 0)
+        {
+            return ImportData(false, true).main(argc-1, argv+1);
+        }
         else
         {
             return sp_process(argc, argv);
@@ -0,0 +1,109 @@
+/******************************************************************************
+ * src/mappedfile.h
+ *
+ * Read-only memory mapping of a complete file.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef MAPPEDFILE_HEADER
+#define MAPPEDFILE_HEADER
+
+#include <cerrno>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//! Read-only memory mapping of a complete regular file.
+class MappedFile
+{
+protected:
+    //! mapped address or NULL
+    void* m_addr;
+
+    //! size of mapping
+    size_t m_size;
+
+    //! non-copyable: mapping is released in destructor
+    MappedFile(const MappedFile&);
+
+    //! non-copyable: mapping is released in destructor
+    MappedFile& operator = (const MappedFile&);
+
+public:
+    //! construct without mapping
+    MappedFile()
+        : m_addr(NULL), m_size(0)
+    {
+    }
+
+    //! release mapping
+    ~MappedFile()
+    {
+        if (m_addr) munmap(m_addr, m_size);
+    }
+
+    //! map a regular, non-empty file for sequential reading. Returns false
+    //! with errno set if the file cannot be opened or mapped, and with errno
+    //! zero if it is not a regular file or empty.
+    bool open(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        {
+            errno = 0;
+            close(fd);
+            return false;
+        }
+
+        void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        int mmap_errno = errno;
+        close(fd);
+
+        if (addr == MAP_FAILED) {
+            errno = mmap_errno;
+            return false;
+        }
+
+        m_addr = addr;
+        m_size = st.st_size;
+
+        madvise(m_addr, m_size, MADV_SEQUENTIAL);
+
+        return true;
+    }
+
+    //! mapped file data
+    const char* data() const
+    {
+        return (const char*)m_addr;
+    }
+
+    //! size of mapped file
+    size_t size() const
+    {
+        return m_size;
+    }
+};
+
+#endif // MAPPEDFILE_HEADER
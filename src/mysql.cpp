@@ -24,9 +24,13 @@
 #include "mysql.h"
 #include "common.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iomanip>
+#include <sstream>
 #include <vector>
 
 //! Opaque structure for MYSQL_BIND
@@ -34,33 +38,91 @@ struct MySqlBind : public MYSQL_BIND
 {
 };
 
+//! boolean type of the client library's interface
+#if defined(LIBMYSQL_VERSION_ID) && LIBMYSQL_VERSION_ID >= 80000
+typedef bool mysql_bool;
+#else
+typedef my_bool mysql_bool;
+#endif
+
 //! Class for result value
 struct MySqlColumn
 {
     //! NULL value indicator
-    #if defined(LIBMYSQL_VERSION_ID) && LIBMYSQL_VERSION_ID >= 80000
-    bool is_null;
-    #else
-    my_bool is_null;
-    #endif
+    mysql_bool is_null;
 
-    //! output string data, currently extra long strings are truncated.
-    char strdata[128];
+    //! truncation indicator
+    mysql_bool error;
 
-    //! output string data length
+    //! output data length, the full length if the value was truncated
     unsigned long length;
 
-    //! initialize internal bind pointers
-    void initialize_as_string(MySqlBind& bind)
+    //! bound type: MYSQL_TYPE_LONGLONG, MYSQL_TYPE_DOUBLE or MYSQL_TYPE_STRING
+    enum_field_types type;
+
+    //! integer column is unsigned
+    bool is_unsigned;
+
+    //! output integer value
+    int64_t ival;
+
+    //! output double value
+    double dval;
+
+    //! output string data, grown to the longest value fetched
+    std::vector<char> strdata;
+
+    //! text representation of a numeric value, formatted on demand
+    std::string text;
+
+    //! text is formatted for the current row
+    bool has_text;
+
+    MySqlColumn()
+        : is_null(0), error(0), length(0), type(MYSQL_TYPE_STRING),
+          is_unsigned(false), ival(0), dval(0), has_text(false)
+    {
+    }
+
+    //! initialize internal bind pointers: integer and double columns are
+    //! bound natively, all others as strings sized to the longest value.
+    void initialize(MySqlBind& bind, const MYSQL_FIELD& field)
     {
-        // buffer
-        bind.buffer_type = MYSQL_TYPE_STRING;
-        bind.buffer = strdata;
-        bind.buffer_length = sizeof(strdata);
+        switch (field.type)
+        {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONGLONG:
+            type = MYSQL_TYPE_LONGLONG;
+            is_unsigned = (field.flags & UNSIGNED_FLAG) != 0;
+            bind.buffer = &ival;
+            bind.buffer_length = sizeof(ival);
+            bind.is_unsigned = is_unsigned;
+            break;
+
+        case MYSQL_TYPE_DOUBLE:
+            type = MYSQL_TYPE_DOUBLE;
+            bind.buffer = &dval;
+            bind.buffer_length = sizeof(dval);
+            break;
+
+        default:
+            type = MYSQL_TYPE_STRING;
+            strdata.resize(std::max(field.max_length, 128ul));
+            bind.buffer = strdata.data();
+            bind.buffer_length = strdata.size();
+            break;
+        }
+
+        bind.buffer_type = type;
         // null
         bind.is_null = &is_null;
         // length
         bind.length = &length;
+        // truncation
+        bind.error = &error;
     }
 };
 
@@ -69,18 +131,7 @@ MySqlQuery::MySqlQuery(class MySqlDatabase& db, const std::string& query)
     : SqlQueryImpl(query),
       m_db(db), m_bind(NULL), m_result(NULL)
 {
-    // allocate prepared statement object
-    m_stmt = mysql_stmt_init(m_db.m_db);
-
-    // prepare statement
-    int rc = mysql_stmt_prepare(m_stmt, query.data(), query.size());
-
-    if (rc != 0)
-    {
-        OUT_THROW("SQL query \"" << query << "\"\n" <<
-                  "Failed : " << mysql_stmt_error(m_stmt));
-    }
-
+    prepare();
     execute();
 }
 
@@ -90,17 +141,7 @@ MySqlQuery::MySqlQuery(class MySqlDatabase& db, const std::string& query,
     : SqlQueryImpl(query),
       m_db(db), m_bind(NULL), m_result(NULL)
 {
-    // allocate prepared statement object
-    m_stmt = mysql_stmt_init(m_db.m_db);
-
-    // prepare statement
-    int rc = mysql_stmt_prepare(m_stmt, query.data(), query.size());
-
-    if (rc != 0)
-    {
-        OUT_THROW("SQL query \"" << query << "\"\n" <<
-                  "Failed : " << mysql_stmt_error(m_stmt));
-    }
+    prepare();
 
     // bind parameters
     MYSQL_BIND bind[params.size()];
@@ -115,7 +156,7 @@ MySqlQuery::MySqlQuery(class MySqlDatabase& db, const std::string& query,
         bind[i].length = &bind[i].buffer_length;
     }
 
-    rc = mysql_stmt_bind_param(m_stmt, bind);
+    int rc = mysql_stmt_bind_param(m_stmt, bind);
 
     if (rc != 0)
     {
@@ -126,10 +167,46 @@ MySqlQuery::MySqlQuery(class MySqlDatabase& db, const std::string& query,
     execute();
 }
 
+//! Take the statement from the database's cache or prepare it, throws on
+//! errors.
+void MySqlQuery::prepare()
+{
+    m_handle = m_db.m_stmt_cache.take(query());
+
+    if (!m_handle)
+    {
+        // allocate prepared statement object
+        MYSQL_STMT* stmt = mysql_stmt_init(m_db.m_db);
+
+        if (!stmt)
+        {
+            OUT_THROW("SQL query \"" << query() << "\"\n" <<
+                      "Failed : " << m_db.errmsg());
+        }
+
+        m_handle = handle_type(stmt, mysql_stmt_close);
+
+        // prepare statement
+        int rc = mysql_stmt_prepare(m_handle.get(), query().data(), query().size());
+
+        if (rc != 0)
+        {
+            OUT_THROW("SQL query \"" << query() << "\"\n" <<
+                      "Failed : " << mysql_stmt_error(m_handle.get()));
+        }
+    }
+
+    m_stmt = m_handle.get();
+}
+
 //! Free result
 MySqlQuery::~MySqlQuery()
 {
-    mysql_stmt_close(m_stmt);
+    // reset the statement and keep it for the next identical query
+    mysql_stmt_free_result(m_stmt);
+    mysql_stmt_reset(m_stmt);
+
+    m_db.m_stmt_cache.put(query(), m_handle);
 
     if (m_bind)
         delete [] m_bind;
@@ -141,6 +218,10 @@ MySqlQuery::~MySqlQuery()
 //! Bind output results and execute query
 void MySqlQuery::execute()
 {
+    // calculate maximum value lengths when storing the result
+    mysql_bool update_max_length = 1;
+    mysql_stmt_attr_set(m_stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &update_max_length);
+
     int rc = mysql_stmt_execute(m_stmt);
 
     if (rc != 0)
@@ -149,25 +230,68 @@ void MySqlQuery::execute()
                   "Failed : " << mysql_stmt_error(m_stmt));
     }
 
+    m_row = -1;
+
+    int cols = num_cols();
+    if (cols == 0) return;
+
+    // transfer the whole result to the client in bulk instead of fetching
+    // each row from the server.
+    if (mysql_stmt_store_result(m_stmt) != 0)
+    {
+        OUT_THROW("SQL execute \"" << query() << "\"\n" <<
+                  "Storing result failed : " << mysql_stmt_error(m_stmt));
+    }
+
     //! Bind all result columns, mysql apparently cannot fetch single column
     //! data, mysql_stmt_fetch_column() segfaults without
     //! mysql_stmt_bind_result().
-    int cols = num_cols();
-
     m_bind = new MySqlBind[cols];
     memset(m_bind, 0, cols * sizeof(MySqlBind));
 
     m_result = new MySqlColumn[cols];
-    memset(m_result, 0, cols * sizeof(MySqlColumn));
+
+    MYSQL_RES* res = mysql_stmt_result_metadata(m_stmt);
 
     for (int c = 0; c < cols; ++c)
     {
-        m_result[c].initialize_as_string(m_bind[c]);
+        m_result[c].initialize(m_bind[c], *mysql_fetch_field_direct(res, c));
     }
 
+    mysql_free_result(res);
+
     mysql_stmt_bind_result(m_stmt, m_bind);
+}
 
-    m_row = -1;
+//! Refetch string columns whose values were longer than their buffers, which
+//! are grown for the following rows.
+void MySqlQuery::refetch_truncated()
+{
+    bool rebind = false;
+
+    for (unsigned int c = 0; c < num_cols(); ++c)
+    {
+        MySqlColumn& col = m_result[c];
+
+        if (!col.error || col.type != MYSQL_TYPE_STRING)
+            continue;
+
+        col.strdata.resize(col.length);
+        m_bind[c].buffer = col.strdata.data();
+        m_bind[c].buffer_length = col.strdata.size();
+
+        if (mysql_stmt_fetch_column(m_stmt, m_bind + c, c, 0) != 0)
+        {
+            OUT_THROW("SQL query \"" << query() << "\"\n" <<
+                      "Fetching column " << c << " failed : " <<
+                      mysql_stmt_error(m_stmt));
+        }
+
+        rebind = true;
+    }
+
+    if (rebind)
+        mysql_stmt_bind_result(m_stmt, m_bind);
 }
 
 //! Return number of rows in result, throws if no tuples.
@@ -228,7 +352,25 @@ unsigned int MySqlQuery::current_row() const
 bool MySqlQuery::step()
 {
     ++m_row;
-    return (mysql_stmt_fetch(m_stmt) == 0);
+
+    // statement has no result columns
+    if (!m_result) return false;
+
+    int rc = mysql_stmt_fetch(m_stmt);
+
+    if (rc == MYSQL_DATA_TRUNCATED) {
+        refetch_truncated();
+        rc = 0;
+    }
+    else if (rc == 1) {
+        OUT_THROW("SQL query \"" << query() << "\"\n" <<
+                  "Fetch failed : " << mysql_stmt_error(m_stmt));
+    }
+
+    for (unsigned int c = 0; c < num_cols(); ++c)
+        m_result[c].has_text = false;
+
+    return (rc == 0);
 }
 
 //! Returns true if cell (row,col) is NULL.
@@ -238,11 +380,77 @@ bool MySqlQuery::isNULL(unsigned int col) const
     return m_result[col].is_null;
 }
 
-//! Return text representation of column col of current row.
-std::string MySqlQuery::text(unsigned int col) const
+//! Return reference to the text representation of column col of current row.
+StringRef MySqlQuery::view(unsigned int col) const
+{
+    assert(col < num_cols());
+    MySqlColumn& r = m_result[col];
+
+    if (r.is_null)
+        return StringRef();
+
+    if (r.type == MYSQL_TYPE_STRING)
+        return StringRef(r.strdata.data(), r.length);
+
+    if (!r.has_text)
+    {
+        char buffer[32];
+        size_t size;
+
+        if (r.type == MYSQL_TYPE_DOUBLE)
+            size = format_double(r.dval, buffer);
+        else if (r.is_unsigned)
+            size = snprintf(buffer, sizeof(buffer), "%llu",
+                            (unsigned long long)r.ival);
+        else
+            size = snprintf(buffer, sizeof(buffer), "%lld", (long long)r.ival);
+
+        r.text.assign(buffer, size);
+        r.has_text = true;
+    }
+
+    return StringRef(r.text);
+}
+
+//! Read column col of current row as a double, natively if it is bound as a
+//! number.
+bool MySqlQuery::as_double(unsigned int col, double& out) const
+{
+    assert(col < num_cols());
+    const MySqlColumn& r = m_result[col];
+
+    if (r.is_null)
+        return false;
+
+    if (r.type == MYSQL_TYPE_LONGLONG) {
+        out = r.is_unsigned ? (double)(uint64_t)r.ival : (double)r.ival;
+        return true;
+    }
+    else if (r.type == MYSQL_TYPE_DOUBLE) {
+        out = r.dval;
+        return true;
+    }
+
+    return SqlQueryImpl::as_double(col, out);
+}
+
+//! Read column col of current row as a 64-bit integer, natively if it is
+//! bound as an integer.
+bool MySqlQuery::as_int64(unsigned int col, int64_t& out) const
 {
     assert(col < num_cols());
-    return std::string(m_result[col].strdata, m_result[col].length);
+    const MySqlColumn& r = m_result[col];
+
+    if (r.is_null)
+        return false;
+
+    if (r.type == MYSQL_TYPE_LONGLONG) {
+        if (r.is_unsigned && r.ival < 0) return false;
+        out = r.ival;
+        return true;
+    }
+
+    return SqlQueryImpl::as_int64(col, out);
 }
 
 //! read complete result into memory
@@ -257,10 +465,192 @@ bool MySqlQuery::isNULL(unsigned int row, unsigned int col) const
     return SqlDataCache::isNULL(row, col);
 }
 
-//! Return text representation of cell (row,col).
-std::string MySqlQuery::text(unsigned int row, unsigned int col) const
+//! Return reference to the text representation of cell (row,col).
+StringRef MySqlQuery::view(unsigned int row, unsigned int col) const
 {
-    return SqlDataCache::text(row, col);
+    return SqlDataCache::view(row, col);
+}
+
+//! Read cell (row,col) as a double from the cache.
+bool MySqlQuery::as_double(unsigned int row, unsigned int col, double& out) const
+{
+    return SqlDataCache::as_double(row, col, out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! Prepare a SQL statement, throws on errors.
+MySqlStatement::MySqlStatement(class MySqlDatabase& db,
+                               const std::string& query,
+                               const ptypes_type& types)
+    : SqlStatementImpl(query, types),
+      m_db(db)
+{
+    // allocate prepared statement object
+    m_stmt = mysql_stmt_init(m_db.m_db);
+
+    // prepare statement
+    int rc = mysql_stmt_prepare(m_stmt, query.data(), query.size());
+
+    if (rc != 0)
+    {
+        std::string errmsg = mysql_stmt_error(m_stmt);
+        mysql_stmt_close(m_stmt);
+
+        OUT_THROW("SQL query \"" << query << "\"\n" <<
+                  "Failed : " << errmsg);
+    }
+}
+
+//! Free statement
+MySqlStatement::~MySqlStatement()
+{
+    mysql_stmt_close(m_stmt);
+}
+
+//! Bind parameters and execute the statement, throws on errors.
+void MySqlStatement::execute(const std::vector<StringRef>& params)
+{
+    // bind parameters
+    std::vector<MYSQL_BIND> bind(params.size());
+    memset(bind.data(), 0, bind.size() * sizeof(MYSQL_BIND));
+
+    m_ints.resize(params.size());
+    m_doubles.resize(params.size());
+
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        bind[i].is_null = 0;
+
+        if (param_int64(i, params[i], m_ints[i]))
+        {
+            bind[i].buffer_type = MYSQL_TYPE_LONGLONG;
+            bind[i].buffer = &m_ints[i];
+        }
+        else if (param_double(i, params[i], m_doubles[i]))
+        {
+            bind[i].buffer_type = MYSQL_TYPE_DOUBLE;
+            bind[i].buffer = &m_doubles[i];
+        }
+        else
+        {
+            bind[i].buffer_type = MYSQL_TYPE_STRING;
+            bind[i].buffer = (char*)params[i].data();
+            bind[i].buffer_length = params[i].size();
+            bind[i].length = &bind[i].buffer_length;
+        }
+    }
+
+    int rc = mysql_stmt_bind_param(m_stmt, bind.data());
+
+    if (rc != 0)
+    {
+        OUT_THROW("SQL bind parameters " << query() << "\n" <<
+                  "Failed with " << mysql_stmt_error(m_stmt));
+    }
+
+    rc = mysql_stmt_execute(m_stmt);
+
+    if (rc != 0)
+    {
+        OUT_THROW("SQL execute \"" << query() << "\"\n" <<
+                  "Failed : " << mysql_stmt_error(m_stmt));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! Start bulk loading into the columns of table.
+MySqlBulkLoad::MySqlBulkLoad(class MySqlDatabase& db, const std::string& table,
+                             const std::vector<std::string>& cols)
+    : SqlBulkLoadImpl(table, cols.size()),
+      m_db(db), m_rows(0), m_col(0)
+{
+    std::ostringstream cmd;
+    cmd << "INSERT INTO " << m_db.quote_field(table) << " (";
+
+    for (size_t i = 0; i < cols.size(); ++i)
+    {
+        if (i != 0) cmd << ',';
+        cmd << m_db.quote_field(cols[i]);
+    }
+
+    cmd << ") VALUES ";
+    m_prefix = cmd.str();
+
+    // keep statements well below the server's packet size limit, but do not
+    // collect more than 16 MiB on the client.
+    size_t max_packet = m_db.max_allowed_packet();
+
+    m_limit = (max_packet > 2048) ? max_packet - 1024 : 1024;
+    m_limit = std::min<size_t>(m_limit, 16 * 1024 * 1024);
+}
+
+//! execute collected multi-row INSERT statement
+void MySqlBulkLoad::flush()
+{
+    if (m_rows == 0) return;
+
+    m_db.execute(m_buffer);
+
+    m_buffer.clear();
+    m_rows = 0;
+}
+
+//! append cell separator if needed
+void MySqlBulkLoad::next_cell()
+{
+    assert(m_col < m_num_cols);
+    m_row += (m_col++ == 0) ? '(' : ',';
+}
+
+//! Append a text cell to the current row.
+void MySqlBulkLoad::put(const StringRef& value)
+{
+    next_cell();
+
+    m_escape.resize(2 * value.size() + 1);
+
+    unsigned long len = mysql_real_escape_string(
+        m_db.m_db, m_escape.data(), value.data(), value.size());
+
+    m_row += '\'';
+    m_row.append(m_escape.data(), len);
+    m_row += '\'';
+}
+
+//! Append a NULL cell to the current row.
+void MySqlBulkLoad::put_null()
+{
+    next_cell();
+    m_row += "NULL";
+}
+
+//! Finish the current row, maybe sends a batch of rows.
+void MySqlBulkLoad::end_row()
+{
+    assert(m_col == m_num_cols);
+    m_row += ')';
+    m_col = 0;
+
+    // send batch if the row would push it beyond max_allowed_packet
+    if (m_rows != 0 && m_buffer.size() + 1 + m_row.size() > m_limit)
+        flush();
+
+    if (m_rows == 0)
+        m_buffer = m_prefix;
+    else
+        m_buffer += ',';
+
+    m_buffer += m_row;
+    m_row.clear();
+    ++m_rows;
+}
+
+//! Send remaining rows, throws on errors.
+void MySqlBulkLoad::finish()
+{
+    flush();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -291,9 +681,19 @@ bool MySqlDatabase::initialize(const std::string& params)
 //! destructor to free connection
 MySqlDatabase::~MySqlDatabase()
 {
+    // close cached statements before the connection
+    m_stmt_cache.clear();
+
     mysql_close(m_db);
 }
 
+//! return hits and misses of the statement cache
+void MySqlDatabase::stmt_cache_stats(size_t& hits, size_t& misses) const
+{
+    hits = m_stmt_cache.hits();
+    misses = m_stmt_cache.misses();
+}
+
 //! return type of SQL database
 MySqlDatabase::db_type MySqlDatabase::type() const
 {
@@ -340,6 +740,40 @@ SqlQuery MySqlDatabase::query(const std::string& query,
     return SqlQuery( new MySqlQuery(*this, query, params) );
 }
 
+//! prepare statement object for repeated execution with placeholders
+SqlStatement MySqlDatabase::prepare(const std::string& query,
+                                       const SqlStatementImpl::ptypes_type& types)
+{
+    return SqlStatement( new MySqlStatement(*this, query, types) );
+}
+
+//! start bulk loading rows into the columns of table using multi-row INSERT
+//! statements
+SqlBulkLoad MySqlDatabase::bulk_load(const std::string& table,
+                                     const std::vector<std::string>& cols)
+{
+    return SqlBulkLoad( new MySqlBulkLoad(*this, table, cols) );
+}
+
+//! query the server's max_allowed_packet variable
+size_t MySqlDatabase::max_allowed_packet()
+{
+    execute("SELECT @@max_allowed_packet");
+
+    MYSQL_RES* res = mysql_store_result(m_db);
+    if (!res) OUT_THROW("max_allowed_packet query failed : " << errmsg());
+
+    size_t size = 1024 * 1024;
+
+    MYSQL_ROW row = mysql_fetch_row(res);
+    if (row && row[0])
+        size = strtoul(row[0], NULL, 10);
+
+    mysql_free_result(res);
+
+    return size;
+}
+
 //! test if a table exists in the database
 bool MySqlDatabase::exist_table(const std::string&)
 {
@@ -349,6 +783,19 @@ bool MySqlDatabase::exist_table(const std::string&)
     return false;
 }
 
+//! return the columns of an existing table in their order
+SqlDatabase::columns_type MySqlDatabase::table_columns(const std::string& table)
+{
+    MySqlQuery sql(*this, "SHOW COLUMNS FROM " + quote_field(table));
+
+    // columns: Field, Type, Null, Key, Default, Extra
+    columns_type cols;
+    while (sql.step())
+        cols.push_back(std::make_pair(sql.text(0), sql.text(1)));
+
+    return cols;
+}
+
 //! return last error message string
 const char* MySqlDatabase::errmsg() const
 {
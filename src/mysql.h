@@ -36,6 +36,12 @@ protected:
     //! MySQL database connection
     class MySqlDatabase& m_db;
 
+    //! type of reference counted statement handle
+    typedef SqlStatementCache<MYSQL_STMT>::handle_type handle_type;
+
+    //! MySQL statement handle, taken from the statement cache
+    handle_type m_handle;
+
     //! MySQL prepared statement object
     MYSQL_STMT* m_stmt;
 
@@ -48,9 +54,16 @@ protected:
     //! Opaque structure used to retrieve results
     struct MySqlColumn* m_result;
 
+    //! Take the statement from the database's cache or prepare it, throws on
+    //! errors.
+    void prepare();
+
     //! Bind output results and execute query
     void execute();
 
+    //! Refetch string columns whose values were longer than their buffers
+    void refetch_truncated();
+
 public:
 
     //! Execute a SQL query without placeholders, throws on errors.
@@ -88,8 +101,17 @@ public:
     //! Returns true if cell (current_row,col) is NULL.
     bool isNULL(unsigned int col) const;
 
-    //! Return text representation of column col of current row.
-    std::string text(unsigned int col) const;
+    //! Return reference to the text representation of column col of current
+    //! row.
+    StringRef view(unsigned int col) const;
+
+    //! Read column col of current row as a double, natively if it is bound
+    //! as a number.
+    bool as_double(unsigned int col, double& out) const;
+
+    //! Read column col of current row as a 64-bit integer, natively if it is
+    //! bound as an integer.
+    bool as_int64(unsigned int col, int64_t& out) const;
 
     // *** Complete Result Caching ***
 
@@ -99,8 +121,94 @@ public:
     //! Returns true if cell (row,col) is NULL.
     bool isNULL(unsigned int row, unsigned int col) const;
 
-    //! Return text representation of cell (row,col).
-    std::string text(unsigned int row, unsigned int col) const;
+    //! Return reference to the text representation of cell (row,col).
+    StringRef view(unsigned int row, unsigned int col) const;
+
+    //! Read cell (row,col) as a double from the cache.
+    bool as_double(unsigned int row, unsigned int col, double& out) const;
+
+    //! cached cells are parsed by the default implementation
+    using SqlQueryImpl::as_int64;
+};
+
+//! MySQL prepared statement without result
+class MySqlStatement : public SqlStatementImpl
+{
+protected:
+    //! MySQL database connection
+    class MySqlDatabase& m_db;
+
+    //! MySQL prepared statement object
+    MYSQL_STMT* m_stmt;
+
+    //! buffers of parameters bound as numbers
+    std::vector<int64_t> m_ints;
+    std::vector<double> m_doubles;
+
+public:
+
+    //! Prepare a SQL statement, throws on errors.
+    MySqlStatement(class MySqlDatabase& db, const std::string& query,
+                       const ptypes_type& types);
+
+    //! Free statement
+    ~MySqlStatement();
+
+    //! Bind parameters and execute the statement, throws on errors.
+    void execute(const std::vector<StringRef>& params);
+};
+
+//! MySQL bulk loader using multi-row INSERT statements
+class MySqlBulkLoad : public SqlBulkLoadImpl
+{
+protected:
+    //! MySQL database connection
+    class MySqlDatabase& m_db;
+
+    //! INSERT INTO ... VALUES prefix of each statement
+    std::string m_prefix;
+
+    //! multi-row INSERT statement collected so far
+    std::string m_buffer;
+
+    //! current row's values tuple
+    std::string m_row;
+
+    //! number of rows in m_buffer
+    size_t m_rows;
+
+    //! number of cells in current row
+    size_t m_col;
+
+    //! maximum statement size, kept below max_allowed_packet
+    size_t m_limit;
+
+    //! escaping buffer for mysql_real_escape_string()
+    std::vector<char> m_escape;
+
+    //! execute collected multi-row INSERT statement
+    void flush();
+
+    //! append cell separator if needed
+    void next_cell();
+
+public:
+
+    //! Start bulk loading into the columns of table.
+    MySqlBulkLoad(class MySqlDatabase& db, const std::string& table,
+                  const std::vector<std::string>& cols);
+
+    //! Append a text cell to the current row.
+    void put(const StringRef& value);
+
+    //! Append a NULL cell to the current row.
+    void put_null();
+
+    //! Finish the current row, maybe sends a batch of rows.
+    void end_row();
+
+    //! Send remaining rows, throws on errors.
+    void finish();
 };
 
 //! MySQL database connection
@@ -110,8 +218,13 @@ protected:
     //! database connection
     MYSQL* m_db;
 
+    //! idle prepared statements of queries
+    SqlStatementCache<MYSQL_STMT> m_stmt_cache;
+
     //! for access to database connection
     friend class MySqlQuery;
+    friend class MySqlStatement;
+    friend class MySqlBulkLoad;
 
 public:
     //! virtual destructor to free connection
@@ -139,11 +252,32 @@ public:
     virtual SqlQuery query(const std::string& query,
                            const std::vector<std::string>& params);
 
+    //! prepare statement object for repeated execution with placeholders of
+    //! the given types.
+    virtual SqlStatement prepare(
+        const std::string& query,
+        const SqlStatementImpl::ptypes_type& types =
+            SqlStatementImpl::ptypes_type());
+
+    //! start bulk loading rows into the columns of table using multi-row
+    //! INSERT statements
+    virtual SqlBulkLoad bulk_load(const std::string& table,
+                                  const std::vector<std::string>& cols);
+
     //! test if a table exists in the database
     virtual bool exist_table(const std::string& table);
 
+    //! return the columns of an existing table in their order
+    virtual columns_type table_columns(const std::string& table);
+
+    //! query the server's max_allowed_packet variable
+    size_t max_allowed_packet();
+
     //! return last error message string
     const char* errmsg() const;
+
+    //! return hits and misses of the statement cache
+    virtual void stmt_cache_stats(size_t& hits, size_t& misses) const;
 };
 
 #endif // HAVE_MYSQL
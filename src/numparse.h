@@ -0,0 +1,159 @@
+/******************************************************************************
+ * src/numparse.h
+ *
+ * Fast parsing of integers and floating point numbers from string views, and
+ * formatting of doubles which reads back exactly.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef NUMPARSE_HEADER
+#define NUMPARSE_HEADER
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <stdint.h>
+
+#include "stringref.h"
+
+//! parse a decimal integer [+-]?[0-9]+, returns false if str is not one or
+//! does not fit into 64 bits.
+static inline bool parse_int64(const StringRef& str, int64_t& out)
+{
+    const char* p = str.begin(), * end = str.end();
+
+    bool neg = false;
+    if (p != end && (*p == '+' || *p == '-')) neg = (*p++ == '-');
+
+    if (p == end) return false;
+
+    uint64_t v = 0;
+    for ( ; p != end; ++p)
+    {
+        if (*p < '0' || *p > '9') return false;
+        if (v > (UINT64_MAX - 9) / 10) return false;
+        v = v * 10 + (*p - '0');
+    }
+
+    if (v > (uint64_t)INT64_MAX + neg) return false;
+
+    out = neg ? (int64_t)(0 - v) : (int64_t)v;
+    return true;
+}
+
+//! parse a decimal floating point number [+-]?[0-9]*.?[0-9]*([eE][+-]?[0-9]+)?
+//! with at least one mantissa digit, returns false if str is not one. Short
+//! numbers are converted exactly with one multiplication or division, others
+//! by strtod(), so the result is always correctly rounded.
+static inline bool parse_double(const StringRef& str, double& out)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = str.begin(), * end = str.end();
+
+    bool neg = false;
+    if (p != end && (*p == '+' || *p == '-')) neg = (*p++ == '-');
+
+    // mantissa digits, counting significant ones and the decimal exponent
+    uint64_t mant = 0;
+    int digits = 0, sigdigits = 0, exp10 = 0;
+
+    for ( ; p != end && *p >= '0' && *p <= '9'; ++p, ++digits)
+    {
+        if (mant == 0 && *p == '0') continue;
+        if (sigdigits < 19) mant = mant * 10 + (*p - '0'), ++sigdigits;
+        else ++exp10;
+    }
+
+    if (p != end && *p == '.')
+    {
+        for (++p; p != end && *p >= '0' && *p <= '9'; ++p, ++digits)
+        {
+            if (mant == 0 && *p == '0') { --exp10; continue; }
+            if (sigdigits < 19) mant = mant * 10 + (*p - '0'), ++sigdigits, --exp10;
+        }
+    }
+
+    if (digits == 0) return false;
+
+    if (p != end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+
+        bool eneg = false;
+        if (p != end && (*p == '+' || *p == '-')) eneg = (*p++ == '-');
+
+        if (p == end) return false;
+
+        int e = 0;
+        for ( ; p != end && *p >= '0' && *p <= '9'; ++p)
+        {
+            if (e < 100000) e = e * 10 + (*p - '0');
+        }
+
+        exp10 += eneg ? -e : e;
+    }
+
+    if (p != end) return false;
+
+    // fast path: mantissa and power of ten are both exact doubles
+    if (mant < (uint64_t(1) << 53) && exp10 >= -22 && exp10 <= 22)
+    {
+        double d = (double)mant;
+        d = (exp10 < 0) ? d / pow10[-exp10] : d * pow10[exp10];
+        out = neg ? -d : d;
+        return true;
+    }
+
+    // slow path: strtod needs a terminated string
+    char buffer[64];
+    std::string large;
+    const char* cstr;
+
+    if (str.size() < sizeof(buffer)) {
+        memcpy(buffer, str.data(), str.size());
+        buffer[str.size()] = 0;
+        cstr = buffer;
+    }
+    else {
+        large.assign(str.data(), str.size());
+        cstr = large.c_str();
+    }
+
+    out = strtod(cstr, NULL);
+    return true;
+}
+
+//! format a double with the fewest of 15, 16 or 17 significant digits which
+//! parses back to the same value. buffer must hold 32 bytes, returns length.
+static inline size_t format_double(double value, char* buffer)
+{
+    for (int prec = 15; prec < 17; ++prec)
+    {
+        int len = snprintf(buffer, 32, "%.*g", prec, value);
+        if (strtod(buffer, NULL) == value) return len;
+    }
+    return snprintf(buffer, 32, "%.17g", value);
+}
+
+#endif // NUMPARSE_HEADER
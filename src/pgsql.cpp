@@ -28,33 +28,52 @@
 #include <cassert>
 #include <cstring>
 #include <iomanip>
+#include <sstream>
 #include <vector>
 
 //! Execute a SQL query without placeholders, throws on errors.
 PgSqlQuery::PgSqlQuery(class PgSqlDatabase& db, const std::string& query)
     : SqlQueryImpl(query),
-      m_db(db)
+      m_db(db), m_res(NULL)
 {
-    m_res = PQexec(m_db.m_pg, query.c_str());
-
-    ExecStatusType r = PQresultStatus(m_res);
-
-    if (r == PGRES_BAD_RESPONSE ||
-        r == PGRES_FATAL_ERROR)
-    {
-        OUT_THROW("SQL query " << query << "\n" <<
-                  "Failed with " << PQresStatus(r) <<
-                  " : " << m_db.errmsg());
-    }
-
-    m_row = -1;
+    execute(std::vector<std::string>());
 }
 
 //! Execute a SQL query with placeholders, throws on errors.
 PgSqlQuery::PgSqlQuery(class PgSqlDatabase& db, const std::string& query,
                        const std::vector<std::string>& params)
     : SqlQueryImpl(query),
-      m_db(db)
+      m_db(db), m_res(NULL)
+{
+    execute(params);
+}
+
+//! Prepare the statement of the query and send its execution, returns false
+//! on errors.
+bool PgSqlQuery::send_prepared(const std::vector<const char*>& params)
+{
+    std::string name = "sqlplot_stmt" + to_str(m_db.m_stmt_counter++);
+
+    PGresult* res = PQprepare(m_db.m_pg, name.c_str(), query().c_str(),
+                              params.size(), NULL);
+
+    ExecStatusType r = PQresultStatus(res);
+    PQclear(res);
+
+    if (r != PGRES_COMMAND_OK)
+        return false;
+
+    m_handle = handle_type(new std::string(name), PgSqlDeallocate(&m_db));
+
+    return PQsendQueryPrepared(m_db.m_pg, name.c_str(), params.size(),
+                               params.data(), NULL, NULL, 0);
+}
+
+//! Send the query using a cached statement, or prepare it if it was run
+//! directly once before, and receive the first row. Queries are run directly
+//! the first time, and always if they contain several commands, since a
+//! failed PREPARE would abort the current transaction. Throws on errors.
+void PgSqlQuery::execute(const std::vector<std::string>& params)
 {
     // construct vector of const char* for interface
     std::vector<const char*> paramsC(params.size());
@@ -62,48 +81,200 @@ PgSqlQuery::PgSqlQuery(class PgSqlDatabase& db, const std::string& query,
     for (size_t i = 0; i < params.size(); ++i)
         paramsC[i] = params[i].c_str();
 
-    // execute query with string variables
-
-    m_res = PQexecParams(m_db.m_pg, query.c_str(),
-                         params.size(), NULL, paramsC.data(), NULL, NULL, 0);
-
-    ExecStatusType r = PQresultStatus(m_res);
-
-    if (r == PGRES_BAD_RESPONSE ||
-        r == PGRES_FATAL_ERROR)
+    while (true)
     {
-        OUT_THROW("SQL query " << query << "\n" <<
-                  "Failed with " << PQresStatus(r) <<
-                  " : " << m_db.errmsg());
+        m_db.finish_stream();
+
+        m_handle = m_db.m_stmt_cache.take(query());
+        bool cached = (m_handle != NULL);
+
+        // true if the query ran directly before as a single command
+        bool* preparable = cached ? NULL : m_db.m_direct_queries.find(query());
+
+        m_direct = false;
+        m_statements = 0;
+        m_failed = false;
+
+        int ok;
+
+        if (m_handle)
+        {
+            ok = PQsendQueryPrepared(m_db.m_pg, m_handle->c_str(),
+                                     params.size(), paramsC.data(),
+                                     NULL, NULL, 0);
+        }
+        else if (preparable && *preparable)
+        {
+            m_db.m_direct_queries.erase(query());
+            ok = send_prepared(paramsC);
+        }
+        else if (params.empty())
+        {
+            m_direct = true;
+            ok = PQsendQuery(m_db.m_pg, query().c_str());
+        }
+        else
+        {
+            m_direct = true;
+            ok = PQsendQueryParams(m_db.m_pg, query().c_str(), params.size(),
+                                   NULL, paramsC.data(), NULL, NULL, 0);
+        }
+
+        if (!ok)
+        {
+            OUT_THROW("SQL query " << query() << "\n" <<
+                      "Failed : " << m_db.errmsg());
+        }
+
+        start();
+
+        // the plan of a cached statement is rejected if the result columns
+        // of the query changed meanwhile, then it is prepared again.
+        if (!m_stale || !cached) return;
+
+        m_handle.reset();
     }
+}
 
+//! Set single-row mode and receive the first row, throws on errors.
+void PgSqlQuery::start()
+{
+    // if single-row mode is refused, results simply contain many rows.
+    PQsetSingleRowMode(m_db.m_pg);
+    m_db.m_stream = this;
+
+    PQclear(m_res);
+    m_res = NULL;
+    m_resrow = 0;
     m_row = -1;
+    m_stale = false;
+
+    m_prefetched = fetch();
 }
 
 //! Free result
 PgSqlQuery::~PgSqlQuery()
 {
+    // the connection is busy until all rows were received
+    if (m_db.m_stream == this)
+        buffer_rest();
+
+    for (size_t i = 0; i < m_pending.size(); ++i)
+        PQclear(m_pending[i]);
+
     PQclear(m_res);
+
+    // keep the prepared statement for the next identical query
+    if (m_handle)
+        m_db.m_stmt_cache.put(query(), m_handle);
 }
 
-//! Return number of rows in result, throws if no tuples.
-unsigned int PgSqlQuery::num_rows() const
+//! Return the next result from the connection, or NULL at the end of the
+//! query, which frees the connection.
+PGresult* PgSqlQuery::get_result()
 {
-    if (PQresultStatus(m_res) != PGRES_TUPLES_OK)
+    PGresult* res = PQgetResult(m_db.m_pg);
+
+    if (res != NULL)
     {
-        OUT_THROW("SQL query " << query() << "\n" <<
-                  "Did not return tuples : " << m_db.errmsg());
+        // count complete results of commands, rows arrive one by one
+        ExecStatusType r = PQresultStatus(res);
+
+        if (r == PGRES_BAD_RESPONSE || r == PGRES_FATAL_ERROR)
+            m_failed = true;
+        else if (r != PGRES_SINGLE_TUPLE)
+            ++m_statements;
+
+        return res;
     }
 
-    int num = PQntuples(m_res);
+    m_db.m_stream = NULL;
 
-    if (num < 0)
+    // remember queries which ran directly, a single command can be prepared
+    // the next time.
+    if (m_direct && !m_failed)
+        m_db.m_direct_queries.insert(query(), m_statements == 1);
+
+    return NULL;
+}
+
+//! Return next result of the query, or NULL at its end.
+PGresult* PgSqlQuery::receive()
+{
+    if (!m_pending.empty())
     {
-        OUT_THROW("SQL query " << query() << "\n" <<
-                  "Did not return tuples : " << m_db.errmsg());
+        PGresult* res = m_pending.front();
+        m_pending.pop_front();
+        return res;
     }
 
-    return num;
+    if (m_db.m_stream != this)
+        return NULL;
+
+    return get_result();
+}
+
+//! Advance m_res to the next result containing rows, returns false at the end
+//! of the query. Throws on errors.
+bool PgSqlQuery::fetch()
+{
+    while (PGresult* res = receive())
+    {
+        ExecStatusType r = PQresultStatus(res);
+
+        if (r == PGRES_BAD_RESPONSE ||
+            r == PGRES_FATAL_ERROR)
+        {
+            std::string errmsg = PQresultErrorMessage(res);
+
+            // detect "cached plan must not change result type"
+            const char* state = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+            m_stale = m_handle && m_row == (unsigned int)-1 && m_res == NULL &&
+                      state && strcmp(state, "0A000") == 0;
+
+            PQclear(res);
+
+            // collect remaining results to free the connection
+            while ((res = receive()) != NULL)
+                PQclear(res);
+
+            if (m_stale) return false;
+
+            OUT_THROW("SQL query " << query() << "\n" <<
+                      "Failed with " << PQresStatus(r) <<
+                      " : " << errmsg);
+        }
+
+        // keep the final result without rows for num_cols() and col_name()
+        PQclear(m_res);
+        m_res = res;
+        m_resrow = 0;
+
+        if (PQntuples(m_res) > 0)
+            return true;
+    }
+
+    return false;
+}
+
+//! Receive all remaining results into m_pending, as the connection is needed
+//! for another command.
+void PgSqlQuery::buffer_rest()
+{
+    assert(m_db.m_stream == this);
+
+    while (PGresult* res = get_result())
+        m_pending.push_back(res);
+}
+
+//! Return number of rows in result, throws if no tuples.
+unsigned int PgSqlQuery::num_rows() const
+{
+    if (SqlDataCache::is_complete())
+        return SqlDataCache::num_rows();
+
+    assert(!"Row number not available without cached result.");
+    return -1;
 }
 
 //! Return column name of col
@@ -115,7 +286,9 @@ std::string PgSqlQuery::col_name(unsigned int col) const
 //! Return number of columns in result, throws if no tuples.
 unsigned int PgSqlQuery::num_cols() const
 {
-    if (PQresultStatus(m_res) != PGRES_TUPLES_OK)
+    ExecStatusType r = PQresultStatus(m_res);
+
+    if (r != PGRES_TUPLES_OK && r != PGRES_SINGLE_TUPLE)
     {
         OUT_THROW("SQL query " << query() << "\n" <<
                   "Did not return tuples : " << m_db.errmsg());
@@ -141,53 +314,330 @@ unsigned int PgSqlQuery::current_row() const
 //! Advance current result row to next (or first if uninitialized)
 bool PgSqlQuery::step()
 {
+    if (m_prefetched) {
+        m_prefetched = false;
+    }
+    else if (m_resrow + 1 < PQntuples(m_res)) {
+        ++m_resrow;
+    }
+    else if (!fetch()) {
+        return false;
+    }
+
     ++m_row;
-    return (m_row < num_rows());
+    return true;
 }
 
 //! Returns true if cell (row,col) is NULL.
 bool PgSqlQuery::isNULL(unsigned int col) const
 {
-    assert(m_row < num_rows());
+    assert(m_resrow < PQntuples(m_res));
     assert(col < num_cols());
-    return PQgetisnull(m_res, m_row, col);
+    return PQgetisnull(m_res, m_resrow, col);
 }
 
-//! Return text representation of column col of current row.
-std::string PgSqlQuery::text(unsigned int col) const
+//! Return reference to the text representation of column col of current row.
+StringRef PgSqlQuery::view(unsigned int col) const
 {
-    assert(m_row < num_rows());
+    assert(m_resrow < PQntuples(m_res));
     assert(col < num_cols());
-    size_t length = PQgetlength(m_res, m_row, col);
-    return std::string(PQgetvalue(m_res, m_row, col), length);
+    size_t length = PQgetlength(m_res, m_resrow, col);
+    return StringRef(PQgetvalue(m_res, m_resrow, col), length);
 }
 
 //! read complete result into memory
 void PgSqlQuery::read_complete()
 {
-    // noop on PostgreSQL
-    return;
+    return SqlDataCache::read_complete(*this);
 }
 
 //! Returns true if cell (row,col) is NULL.
 bool PgSqlQuery::isNULL(unsigned int row, unsigned int col) const
 {
-    assert(row < num_rows());
-    assert(col < num_cols());
-    return PQgetisnull(m_res, row, col);
+    return SqlDataCache::isNULL(row, col);
 }
 
-//! Return text representation of cell (row,col).
-std::string PgSqlQuery::text(unsigned int row, unsigned int col) const
+//! Return reference to the text representation of cell (row,col).
+StringRef PgSqlQuery::view(unsigned int row, unsigned int col) const
 {
-    assert(row < num_rows());
-    assert(col < num_cols());
-    size_t length = PQgetlength(m_res, row, col);
-    return std::string(PQgetvalue(m_res, row, col), length);
+    return SqlDataCache::view(row, col);
+}
+
+//! Read cell (row,col) as a double from the cache.
+bool PgSqlQuery::as_double(unsigned int row, unsigned int col, double& out) const
+{
+    return SqlDataCache::as_double(row, col, out);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+//! Prepare a SQL statement, throws on errors.
+PgSqlStatement::PgSqlStatement(class PgSqlDatabase& db,
+                               const std::string& query,
+                               const ptypes_type& types)
+    : SqlStatementImpl(query, types),
+      m_db(db)
+{
+    m_name = "sqlplot_stmt" + to_str(m_db.m_stmt_counter++);
+
+    m_db.finish_stream();
+
+    // declare numeric parameters, which are sent in binary format
+    std::vector<Oid> oids(types.size(), 0);
+
+    for (size_t i = 0; i < types.size(); ++i)
+    {
+        if (types[i] == PARAM_INTEGER || types[i] == PARAM_NATIVE_INTEGER)
+            oids[i] = 20;       // INT8OID
+        else if (types[i] == PARAM_DOUBLE || types[i] == PARAM_NATIVE_DOUBLE)
+            oids[i] = 701;      // FLOAT8OID
+    }
+
+    PGresult* res = PQprepare(m_db.m_pg, m_name.c_str(), query.c_str(),
+                              oids.size(), oids.empty() ? NULL : oids.data());
+
+    ExecStatusType r = PQresultStatus(res);
+    PQclear(res);
+
+    if (r != PGRES_COMMAND_OK)
+    {
+        OUT_THROW("SQL query " << query << "\n" <<
+                  "Prepare failed with " << PQresStatus(r) <<
+                  " : " << m_db.errmsg());
+    }
+}
+
+//! Deallocate the prepared statement of a cached handle on the server.
+void PgSqlDeallocate::operator () (std::string* name) const
+{
+    // the statement vanishes with a closed connection anyway.
+    if (m_db->m_pg)
+    {
+        m_db->finish_stream();
+        PQclear(PQexec(m_db->m_pg, ("DEALLOCATE " + *name).c_str()));
+    }
+
+    delete name;
+}
+
+//! Deallocate statement
+PgSqlStatement::~PgSqlStatement()
+{
+    // errors are ignored, the statement vanishes with the connection anyway.
+    m_db.finish_stream();
+    PQclear(PQexec(m_db.m_pg, ("DEALLOCATE " + m_name).c_str()));
+}
+
+//! Bind parameters and execute the statement, throws on errors.
+void PgSqlStatement::execute(const std::vector<StringRef>& params)
+{
+    // copy parameters into zero-terminated strings or big-endian binary
+    // numbers for the interface
+    m_parambuf.clear();
+
+    std::vector<int> lengths(params.size()), formats(params.size());
+
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        int64_t ival;
+        double dval;
+        uint64_t bits;
+
+        if (param_int64(i, params[i], ival)) {
+            bits = ival;
+        }
+        else if (param_double(i, params[i], dval)) {
+            memcpy(&bits, &dval, sizeof(bits));
+        }
+        else {
+            m_parambuf.append(params[i].data(), params[i].size());
+            m_parambuf += '\0';
+            lengths[i] = params[i].size() + 1;
+            formats[i] = 0;
+            continue;
+        }
+
+        for (int b = 7; b >= 0; --b)
+            m_parambuf += (char)(bits >> (8 * b));
+
+        lengths[i] = 8;
+        formats[i] = 1;
+    }
+
+    std::vector<const char*> paramsC(params.size());
+
+    for (size_t i = 0, pos = 0; i < params.size(); ++i)
+    {
+        paramsC[i] = m_parambuf.data() + pos;
+        pos += lengths[i];
+    }
+
+    m_db.finish_stream();
+
+    PGresult* res = PQexecPrepared(m_db.m_pg, m_name.c_str(), params.size(),
+                                   paramsC.data(), lengths.data(),
+                                   formats.data(), 0);
+
+    ExecStatusType r = PQresultStatus(res);
+    PQclear(res);
+
+    if (r != PGRES_COMMAND_OK && r != PGRES_TUPLES_OK)
+    {
+        OUT_THROW("SQL query " << query() << "\n" <<
+                  "Failed with " << PQresStatus(r) <<
+                  " : " << m_db.errmsg());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! Start COPY into the columns of table, throws on errors.
+PgSqlBulkLoad::PgSqlBulkLoad(class PgSqlDatabase& db, const std::string& table,
+                             const std::vector<std::string>& cols)
+    : SqlBulkLoadImpl(table, cols.size()),
+      m_db(db), m_col(0), m_active(false)
+{
+    std::ostringstream cmd;
+    cmd << "COPY " << m_db.quote_field(table) << " (";
+
+    for (size_t i = 0; i < cols.size(); ++i)
+    {
+        if (i != 0) cmd << ',';
+        cmd << m_db.quote_field(cols[i]);
+    }
+
+    cmd << ") FROM STDIN";
+
+    m_db.finish_stream();
+
+    PGresult* res = PQexec(m_db.m_pg, cmd.str().c_str());
+
+    ExecStatusType r = PQresultStatus(res);
+    PQclear(res);
+
+    if (r != PGRES_COPY_IN)
+    {
+        OUT_THROW("SQL query " << cmd.str() << "\n" <<
+                  "Failed with " << PQresStatus(r) <<
+                  " : " << m_db.errmsg());
+    }
+
+    m_active = true;
+}
+
+//! Abort COPY if not finished.
+PgSqlBulkLoad::~PgSqlBulkLoad()
+{
+    if (!m_active) return;
+
+    PQputCopyEnd(m_db.m_pg, "bulk load aborted");
+
+    PGresult* res;
+    while ((res = PQgetResult(m_db.m_pg)) != NULL)
+        PQclear(res);
+}
+
+//! send buffered COPY data to the server
+void PgSqlBulkLoad::flush()
+{
+    if (m_buffer.empty()) return;
+
+    if (PQputCopyData(m_db.m_pg, m_buffer.data(), m_buffer.size()) != 1)
+    {
+        OUT_THROW("COPY into " << m_table << "\n" <<
+                  "Failed : " << m_db.errmsg());
+    }
+
+    m_buffer.clear();
+}
+
+//! append cell separator if needed
+void PgSqlBulkLoad::next_cell()
+{
+    assert(m_col < m_num_cols);
+    if (m_col++ != 0) m_buffer += '\t';
+}
+
+//! Append a text cell to the current row.
+void PgSqlBulkLoad::put(const StringRef& value)
+{
+    next_cell();
+
+    // escape special characters of the COPY text format
+    for (StringRef::const_iterator c = value.begin(); c != value.end(); ++c)
+    {
+        switch (*c)
+        {
+        case '\\': m_buffer += "\\\\"; break;
+        case '\t': m_buffer += "\\t"; break;
+        case '\n': m_buffer += "\\n"; break;
+        case '\r': m_buffer += "\\r"; break;
+        default: m_buffer += *c; break;
+        }
+    }
+}
+
+//! Append a NULL cell to the current row.
+void PgSqlBulkLoad::put_null()
+{
+    next_cell();
+    m_buffer += "\\N";
+}
+
+//! Finish the current row.
+void PgSqlBulkLoad::end_row()
+{
+    assert(m_col == m_num_cols);
+    m_buffer += '\n';
+    m_col = 0;
+
+    // send data in pieces of about 256 KiB
+    if (m_buffer.size() >= 256 * 1024u)
+        flush();
+}
+
+//! Send remaining data and end the COPY, throws on errors.
+void PgSqlBulkLoad::finish()
+{
+    flush();
+
+    m_active = false;
+
+    if (PQputCopyEnd(m_db.m_pg, NULL) != 1)
+    {
+        OUT_THROW("COPY into " << m_table << "\n" <<
+                  "Failed : " << m_db.errmsg());
+    }
+
+    // collect final result of COPY command
+    bool good = true;
+    std::string errmsg;
+
+    PGresult* res;
+    while ((res = PQgetResult(m_db.m_pg)) != NULL)
+    {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK && good) {
+            good = false;
+            errmsg = m_db.errmsg();
+        }
+        PQclear(res);
+    }
+
+    if (!good)
+    {
+        OUT_THROW("COPY into " << m_table << "\n" <<
+                  "Failed : " << errmsg);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! constructor without connection
+PgSqlDatabase::PgSqlDatabase()
+    : m_pg(NULL), m_stmt_counter(0), m_stream(NULL), m_direct_queries(256)
+{
+}
+
 //! try to connect to the database with default parameters
 bool PgSqlDatabase::initialize(const std::string& params)
 {
@@ -210,6 +660,17 @@ bool PgSqlDatabase::initialize(const std::string& params)
 PgSqlDatabase::~PgSqlDatabase()
 {
     PQfinish(m_pg);
+    m_pg = NULL;
+
+    // free cached statement handles without deallocating them
+    m_stmt_cache.clear();
+}
+
+//! return hits and misses of the statement cache
+void PgSqlDatabase::stmt_cache_stats(size_t& hits, size_t& misses) const
+{
+    hits = m_stmt_cache.hits();
+    misses = m_stmt_cache.misses();
 }
 
 //! return type of SQL database
@@ -233,6 +694,8 @@ std::string PgSqlDatabase::quote_field(const std::string& field) const
 //! execute SQL query without result
 bool PgSqlDatabase::execute(const std::string& query)
 {
+    finish_stream();
+
     PGresult* res = PQexec(m_pg, query.c_str());
 
     ExecStatusType r = PQresultStatus(res);
@@ -267,6 +730,20 @@ SqlQuery PgSqlDatabase::query(const std::string& query,
     return SqlQuery( new PgSqlQuery(*this, query, params) );
 }
 
+//! prepare statement object for repeated execution with placeholders
+SqlStatement PgSqlDatabase::prepare(const std::string& query,
+                                       const SqlStatementImpl::ptypes_type& types)
+{
+    return SqlStatement( new PgSqlStatement(*this, query, types) );
+}
+
+//! start bulk loading rows into the columns of table using COPY
+SqlBulkLoad PgSqlDatabase::bulk_load(const std::string& table,
+                                     const std::vector<std::string>& cols)
+{
+    return SqlBulkLoad( new PgSqlBulkLoad(*this, table, cols) );
+}
+
 //! test if a table exists in the database
 bool PgSqlDatabase::exist_table(const std::string& table)
 {
@@ -277,12 +754,40 @@ bool PgSqlDatabase::exist_table(const std::string& table)
                    "SELECT COUNT(*) FROM pg_tables WHERE tablename = $1",
                    params);
 
-    assert(sql.num_rows() == 1 && sql.num_cols() == 1);
+    assert(sql.num_cols() == 1);
     sql.step();
 
     return (sql.text(0) != "0");
 }
 
+//! return the columns of an existing table in their order
+SqlDatabase::columns_type PgSqlDatabase::table_columns(const std::string& table)
+{
+    std::vector<std::string> params;
+    params.push_back(quote_field(table));
+
+    // resolve the name like queries do, including temporary tables
+    PgSqlQuery sql(*this,
+                   "SELECT attname, format_type(atttypid, atttypmod) "
+                   "FROM pg_attribute WHERE attrelid = $1::regclass "
+                   "AND attnum > 0 AND NOT attisdropped ORDER BY attnum",
+                   params);
+
+    columns_type cols;
+    while (sql.step())
+        cols.push_back(std::make_pair(sql.text(0), sql.text(1)));
+
+    return cols;
+}
+
+//! buffer the remaining rows of a streaming query, must be called before
+//! sending any other command over the connection.
+void PgSqlDatabase::finish_stream()
+{
+    if (m_stream)
+        m_stream->buffer_rest();
+}
+
 //! return last error message string
 const char* PgSqlDatabase::errmsg() const
 {
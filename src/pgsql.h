@@ -28,20 +28,102 @@
 
 #include <libpq-fe.h>
 
+#include <deque>
+
 #include "sql.h"
 
-class PgSqlQuery : public SqlQueryImpl
+//! Deleter of cached statement handles, which deallocates the prepared
+//! statement on the server.
+struct PgSqlDeallocate
+{
+    //! database connection of the statement
+    class PgSqlDatabase* m_db;
+
+    explicit PgSqlDeallocate(class PgSqlDatabase* db)
+        : m_db(db)
+    {
+    }
+
+    //! deallocate statement and free its name
+    void operator () (std::string* name) const;
+};
+
+/*!
+ * PostgreSQL query, whose rows are streamed from the server in single-row
+ * mode, hence only the current row is held in memory unless read_complete()
+ * caches the result. While rows are pending, the connection is busy; issuing
+ * another command first buffers the remaining rows of the query.
+ */
+class PgSqlQuery : public SqlQueryImpl, protected SqlDataCache
 {
 protected:
     //! PostgreSQL database connection
     class PgSqlDatabase& m_db;
 
-    //! PostgreSQL result object
+    //! type of reference counted statement handle: the statement's name
+    typedef SqlStatementCache<std::string>::handle_type handle_type;
+
+    //! prepared statement taken from the statement cache, empty if the query
+    //! was run directly
+    handle_type m_handle;
+
+    //! query was sent directly without preparing it
+    bool m_direct;
+
+    //! number of complete results of commands received
+    size_t m_statements;
+
+    //! an error result was received
+    bool m_failed;
+
+    //! PostgreSQL result object containing the current row, or the final
+    //! result without rows
     PGresult* m_res;
 
+    //! Current row inside m_res
+    int m_resrow;
+
     //! Current result row
     unsigned int m_row;
 
+    //! First row was received by the constructor, but not yet stepped to
+    bool m_prefetched;
+
+    //! Results received early because the connection was needed otherwise
+    std::deque<PGresult*> m_pending;
+
+    //! Cached statement's plan was rejected because the result type changed
+    bool m_stale;
+
+    //! Prepare the statement of the query and send its execution, returns
+    //! false on errors.
+    bool send_prepared(const std::vector<const char*>& params);
+
+    //! Send the query using a cached statement, or prepare it if it was run
+    //! directly once before, and receive the first row. Throws on errors.
+    void execute(const std::vector<std::string>& params);
+
+    //! Set single-row mode and receive the first row, throws on errors.
+    void start();
+
+    //! Return the next result from the connection, or NULL at the end of the
+    //! query, which frees the connection.
+    PGresult* get_result();
+
+    //! Return next result of the query, or NULL at its end.
+    PGresult* receive();
+
+    //! Advance m_res to the next result containing rows, returns false at
+    //! the end of the query. Throws on errors.
+    bool fetch();
+
+    //! Receive all remaining results into m_pending, as the connection is
+    //! needed for another command.
+    void buffer_rest();
+
+    //! for buffer_rest()
+    friend class PgSqlDatabase;
+
 public:
     
     //! Execute a SQL query without placeholders, throws on errors.
@@ -76,8 +158,9 @@ public:
     //! Returns true if cell (current_row,col) is NULL.
     bool isNULL(unsigned int col) const;
 
-    //! Return text representation of column col of current row.
-    std::string text(unsigned int col) const;
+    //! Return reference to the text representation of column col of current
+    //! row.
+    StringRef view(unsigned int col) const;
 
     // *** Complete Result Caching ***
 
@@ -87,8 +170,84 @@ public:
     //! Returns true if cell (row,col) is NULL.
     bool isNULL(unsigned int row, unsigned int col) const;
 
-    //! Return text representation of cell (row,col).
-    std::string text(unsigned int row, unsigned int col) const;
+    //! Return reference to the text representation of cell (row,col).
+    StringRef view(unsigned int row, unsigned int col) const;
+
+    //! Read cell (row,col) as a double from the cache.
+    bool as_double(unsigned int row, unsigned int col, double& out) const;
+
+    //! current row accessors are inherited
+    using SqlQueryImpl::as_double;
+};
+
+//! PostgreSQL prepared statement, named uniquely on the connection
+class PgSqlStatement : public SqlStatementImpl
+{
+protected:
+    //! PostgreSQL database connection
+    class PgSqlDatabase& m_db;
+
+    //! server-side name of prepared statement
+    std::string m_name;
+
+    //! reused buffer of zero-terminated parameters
+    std::string m_parambuf;
+
+public:
+
+    //! Prepare a SQL statement, throws on errors.
+    PgSqlStatement(class PgSqlDatabase& db, const std::string& query,
+                       const ptypes_type& types);
+
+    //! Deallocate statement
+    ~PgSqlStatement();
+
+    //! Bind parameters and execute the statement, throws on errors.
+    void execute(const std::vector<StringRef>& params);
+};
+
+//! PostgreSQL bulk loader using COPY ... FROM STDIN
+class PgSqlBulkLoad : public SqlBulkLoadImpl
+{
+protected:
+    //! PostgreSQL database connection
+    class PgSqlDatabase& m_db;
+
+    //! buffer of COPY text format data not yet sent
+    std::string m_buffer;
+
+    //! number of cells in current row
+    size_t m_col;
+
+    //! true while the COPY is in progress
+    bool m_active;
+
+    //! send buffered COPY data to the server
+    void flush();
+
+    //! append cell separator if needed
+    void next_cell();
+
+public:
+
+    //! Start COPY into the columns of table, throws on errors.
+    PgSqlBulkLoad(class PgSqlDatabase& db, const std::string& table,
+                  const std::vector<std::string>& cols);
+
+    //! Abort COPY if not finished.
+    ~PgSqlBulkLoad();
+
+    //! Append a text cell to the current row.
+    void put(const StringRef& value);
+
+    //! Append a NULL cell to the current row.
+    void put_null();
+
+    //! Finish the current row.
+    void end_row();
+
+    //! Send remaining data and end the COPY, throws on errors.
+    void finish();
 };
 
 //! PostgreSQL database connection
@@ -98,10 +257,33 @@ protected:
     //! database connection
     PGconn* m_pg;
 
+    //! counter to generate unique prepared statement names
+    unsigned int m_stmt_counter;
+
+    //! query whose rows are currently streamed over the connection
+    class PgSqlQuery* m_stream;
+
+    //! idle prepared statements of queries, by name
+    SqlStatementCache<std::string> m_stmt_cache;
+
+    //! queries run directly, true if they are a single command which is
+    //! prepared when run again, false if they can never be prepared.
+    LruCache<std::string, bool> m_direct_queries;
+
+    //! buffer the remaining rows of a streaming query, must be called before
+    //! sending any other command over the connection.
+    void finish_stream();
+
     //! for access to database connection
     friend class PgSqlQuery;
+    friend class PgSqlStatement;
+    friend class PgSqlBulkLoad;
+    friend struct PgSqlDeallocate;
 
 public:
+    //! constructor without connection
+    PgSqlDatabase();
+
     //! virtual destructor to free connection
     virtual ~PgSqlDatabase();
 
@@ -127,11 +309,28 @@ public:
     virtual SqlQuery query(const std::string& query,
                            const std::vector<std::string>& params);
 
+    //! prepare statement object for repeated execution with placeholders of
+    //! the given types.
+    virtual SqlStatement prepare(
+        const std::string& query,
+        const SqlStatementImpl::ptypes_type& types =
+            SqlStatementImpl::ptypes_type());
+
+    //! start bulk loading rows into the columns of table using COPY
+    virtual SqlBulkLoad bulk_load(const std::string& table,
+                                  const std::vector<std::string>& cols);
+
     //! test if a table exists in the database
     virtual bool exist_table(const std::string& table);
 
+    //! return the columns of an existing table in their order
+    virtual columns_type table_columns(const std::string& table);
+
     //! return last error message string
     virtual const char* errmsg() const;
+
+    //! return hits and misses of the statement cache
+    virtual void stmt_cache_stats(size_t& hits, size_t& misses) const;
 };
 
 #endif // HAVE_POSTGRESQL
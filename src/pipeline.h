@@ -0,0 +1,228 @@
+/******************************************************************************
+ * src/pipeline.h
+ *
+ * Ordered parallel pipeline: chunks pushed by a reader are processed by a
+ * pool of worker threads and then handed to a single writer thread in their
+ * original order.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef PIPELINE_HEADER
+#define PIPELINE_HEADER
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * Three stage pipeline: the thread calling push() is the reader, a number of
+ * worker threads run the work function on chunks in any order, and one writer
+ * thread runs the write function on the chunks in the order they were
+ * pushed. The first exception thrown by a work or write function stops all
+ * further writing and is rethrown by the next push() or finish().
+ */
+template <typename Chunk>
+class OrderedPipeline
+{
+public:
+    //! type of work and write functions
+    typedef std::function<void (Chunk&)> func_type;
+
+protected:
+    //! chunk in flight with completion flag
+    struct Item
+    {
+        Chunk chunk;
+        bool done;
+    };
+
+    //! shared pointer to items, held by both queues
+    typedef std::shared_ptr<Item> item_ptr;
+
+    //! work and write functions
+    func_type m_work, m_write;
+
+    //! maximum number of chunks in flight
+    size_t m_max_inflight;
+
+    //! lock for all following fields
+    std::mutex m_mutex;
+
+    //! signals new work, completed work and free space
+    std::condition_variable m_cv_work, m_cv_done, m_cv_space;
+
+    //! chunks waiting for a worker
+    std::deque<item_ptr> m_work_queue;
+
+    //! all chunks in flight in push order, for the writer
+    std::deque<item_ptr> m_order_queue;
+
+    //! no more chunks will be pushed
+    bool m_closing;
+
+    //! first exception of a work or write function
+    std::exception_ptr m_error;
+
+    //! worker threads
+    std::vector<std::thread> m_workers;
+
+    //! writer thread
+    std::thread m_writer;
+
+    //! worker thread main loop
+    void worker()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (true)
+        {
+            while (m_work_queue.empty() && !m_closing)
+                m_cv_work.wait(lock);
+
+            if (m_work_queue.empty()) break;
+
+            item_ptr item = m_work_queue.front();
+            m_work_queue.pop_front();
+
+            if (!m_error)
+            {
+                lock.unlock();
+                try {
+                    m_work(item->chunk);
+                }
+                catch (...) {
+                    lock.lock();
+                    if (!m_error) m_error = std::current_exception();
+                    lock.unlock();
+                }
+                lock.lock();
+            }
+
+            item->done = true;
+            m_cv_done.notify_all();
+        }
+    }
+
+    //! writer thread main loop
+    void writer()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (true)
+        {
+            while (!(!m_order_queue.empty() && m_order_queue.front()->done) &&
+                   !(m_order_queue.empty() && m_closing))
+                m_cv_done.wait(lock);
+
+            if (m_order_queue.empty()) break;
+
+            item_ptr item = m_order_queue.front();
+            m_order_queue.pop_front();
+            m_cv_space.notify_all();
+
+            if (!m_error)
+            {
+                lock.unlock();
+                try {
+                    m_write(item->chunk);
+                }
+                catch (...) {
+                    lock.lock();
+                    if (!m_error) m_error = std::current_exception();
+                    lock.unlock();
+                }
+                lock.lock();
+            }
+        }
+    }
+
+    //! close queues and join all threads
+    void join()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_closing = true;
+            m_cv_work.notify_all();
+            m_cv_done.notify_all();
+        }
+
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+            if (m_workers[i].joinable()) m_workers[i].join();
+        }
+
+        if (m_writer.joinable()) m_writer.join();
+    }
+
+public:
+    //! start worker and writer threads
+    OrderedPipeline(unsigned int num_workers,
+                    const func_type& work, const func_type& write)
+        : m_work(work), m_write(write),
+          m_max_inflight(4 * num_workers),
+          m_closing(false)
+    {
+        for (unsigned int i = 0; i < num_workers; ++i)
+            m_workers.push_back(std::thread(&OrderedPipeline::worker, this));
+
+        m_writer = std::thread(&OrderedPipeline::writer, this);
+    }
+
+    //! stop all threads, discarding any error.
+    ~OrderedPipeline()
+    {
+        join();
+    }
+
+    //! push a chunk into the pipeline, blocks while too many chunks are in
+    //! flight. Rethrows errors of the work or write functions.
+    void push(Chunk&& chunk)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (m_order_queue.size() >= m_max_inflight && !m_error)
+            m_cv_space.wait(lock);
+
+        if (m_error) std::rethrow_exception(m_error);
+
+        item_ptr item = std::make_shared<Item>();
+        item->chunk = std::move(chunk);
+        item->done = false;
+
+        m_work_queue.push_back(item);
+        m_order_queue.push_back(item);
+
+        m_cv_work.notify_one();
+    }
+
+    //! wait until all chunks are written and stop the threads. Rethrows
+    //! errors of the work or write functions.
+    void finish()
+    {
+        join();
+
+        if (m_error) std::rethrow_exception(m_error);
+    }
+};
+
+#endif // PIPELINE_HEADER
@@ -580,12 +580,14 @@ void Reformat::prepare(const SqlQuery& sql)
                 !m_fmt.readdata())
                 continue;
 
-            std::string text = sql->text(i,j);
-            if (text.size() == 0) continue;
+            StringRef view = sql->view(i,j);
+            if (view.size() == 0) continue;
 
             double v;
-            if (from_str(text, v))
+            if (sql->as_double(i, j, v))
             {
+                std::string text = view.str();
+
                 if (v < m_rowfmt[i].m_min_value)
                 {
                     m_rowfmt[i].m_min_value = v;
@@ -632,12 +634,33 @@ protected:
 //! Reformat SQL data in cell (row,col) according to formats
 std::string Reformat::format(int row, int col, const std::string& in_text) const
 {
-    std::string text = in_text;
+    if (in_text.size() == 0) return in_text;
+
+    double v;
+    bool numeric = from_str(in_text, v);
 
-    if (text.size() == 0) return text;
+    return format(row, col, in_text, numeric, v);
+}
+
+//! Reformat cell (row,col) of a completely cached SQL answer
+std::string Reformat::format(int row, int col, const SqlQuery& sql) const
+{
+    StringRef view = sql->view(row, col);
+    if (view.size() == 0) return std::string();
 
     double v;
-    if (from_str(text, v))
+    bool numeric = sql->as_double(row, col, v);
+
+    return format(row, col, view.str(), numeric, v);
+}
+
+//! Reformat text of a cell, which is the number v if numeric
+std::string Reformat::format(int row, int col, const std::string& in_text,
+                             bool numeric, double v) const
+{
+    std::string text = in_text;
+
+    if (numeric)
     {
         Line fmt = m_fmt;
 
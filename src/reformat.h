@@ -203,6 +203,15 @@ public:
 
     //! Reformat SQL data in cell (row,col) according to formats
     std::string format(int row, int col, const std::string& in_text) const;
+
+    //! Reformat cell (row,col) of a completely cached SQL answer, using its
+    //! numeric value if available
+    std::string format(int row, int col, const SqlQuery& sql) const;
+
+protected:
+    //! Reformat text of a cell, which is the number v if numeric
+    std::string format(int row, int col, const std::string& in_text,
+                       bool numeric, double v) const;
 };
 
 #endif // REFORMAT_HEADER
@@ -0,0 +1,172 @@
+/******************************************************************************
+ * src/spillfile.cpp
+ *
+ * Temporary binary run file of split key=value rows, used to bound the memory
+ * of cached lines.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "spillfile.h"
+#include "common.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <stdint.h>
+#include <unistd.h>
+
+//! create temporary file in $TMPDIR or /tmp, throws on errors.
+SpillFile::SpillFile()
+    : m_file(NULL), m_rows(0), m_bytes(0)
+{
+    const char* tmpdir = getenv("TMPDIR");
+    std::string path = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") +
+                       "/sqlplot-spill-XXXXXX";
+
+    std::vector<char> pathbuf(path.begin(), path.end());
+    pathbuf.push_back(0);
+
+    int fd = mkstemp(pathbuf.data());
+    if (fd < 0)
+        OUT_THROW("Error creating spill file " << path << ": " << strerror(errno));
+
+    // remove name, the file vanishes when closed
+    unlink(pathbuf.data());
+
+    m_file = fdopen(fd, "w+b");
+    if (!m_file) {
+        close(fd);
+        OUT_THROW("Error opening spill file: " << strerror(errno));
+    }
+
+    setvbuf(m_file, NULL, _IOFBF, 1024 * 1024);
+}
+
+//! close and thereby remove the file
+SpillFile::~SpillFile()
+{
+    if (m_file) fclose(m_file);
+}
+
+//! write data to the file, throws on errors
+void SpillFile::write_data(const void* data, size_t size)
+{
+    if (fwrite(data, 1, size, m_file) != size)
+        OUT_THROW("Error writing spill file: " << strerror(errno));
+
+    m_bytes += size;
+}
+
+//! read data from the file, returns false at the end, throws on errors
+bool SpillFile::read_data(void* data, size_t size)
+{
+    size_t rb = fread(data, 1, size, m_file);
+    if (rb == size) return true;
+
+    if (ferror(m_file))
+        OUT_THROW("Error reading spill file: " << strerror(errno));
+    if (rb != 0)
+        OUT_THROW("Error reading spill file: truncated row");
+
+    return false;
+}
+
+//! append a row of line, key ids and values
+void SpillFile::write(const StringRef& line,
+                      const std::vector<KeyTable::id_type>& keys,
+                      const std::vector<StringRef>& values)
+{
+    // row text is the line followed by values which are not part of it
+    m_text.assign(line.data(), line.size());
+    m_table.clear();
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        uint32_t voff, vsize = values[i].size();
+
+        if (values[i].begin() >= line.begin() && values[i].end() <= line.end()) {
+            voff = values[i].begin() - line.begin();
+        }
+        else {
+            voff = m_text.size();
+            m_text.append(values[i].data(), values[i].size());
+        }
+
+        m_table.append((const char*)&keys[i], sizeof(keys[i]));
+        m_table.append((const char*)&voff, sizeof(voff));
+        m_table.append((const char*)&vsize, sizeof(vsize));
+    }
+
+    uint32_t header[4] = {
+        (uint32_t)m_text.size(), (uint32_t)line.size(),
+        (uint32_t)m_table.size(), (uint32_t)keys.size()
+    };
+
+    write_data(header, sizeof(header));
+    write_data(m_text.data(), m_text.size());
+    write_data(m_table.data(), m_table.size());
+
+    ++m_rows;
+}
+
+//! seek to the first row for reading
+void SpillFile::rewind()
+{
+    if (fflush(m_file) != 0 || fseek(m_file, 0, SEEK_SET) != 0)
+        OUT_THROW("Error seeking spill file: " << strerror(errno));
+}
+
+//! read the next row, returns false at the end.
+bool SpillFile::read(StringRef& line,
+                     std::vector<KeyTable::id_type>& keys,
+                     std::vector<StringRef>& values)
+{
+    uint32_t header[4];
+    if (!read_data(header, sizeof(header)))
+        return false;
+
+    m_text.resize(header[0]);
+    m_table.resize(header[2]);
+
+    if (!read_data(&m_text[0], m_text.size()) ||
+        !read_data(&m_table[0], m_table.size()))
+        OUT_THROW("Error reading spill file: truncated row");
+
+    line = StringRef(m_text.data(), header[1]);
+
+    keys.resize(header[3]);
+    values.resize(header[3]);
+
+    const char* t = m_table.data();
+
+    for (size_t i = 0; i < header[3]; ++i)
+    {
+        uint32_t voff, vsize;
+
+        memcpy(&keys[i], t, sizeof(keys[i])), t += sizeof(keys[i]);
+        memcpy(&voff, t, sizeof(voff)), t += sizeof(voff);
+        memcpy(&vsize, t, sizeof(vsize)), t += sizeof(vsize);
+
+        values[i] = StringRef(m_text.data() + voff, vsize);
+    }
+
+    return true;
+}
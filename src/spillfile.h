@@ -0,0 +1,102 @@
+/******************************************************************************
+ * src/spillfile.h
+ *
+ * Temporary binary run file of split key=value rows, used to bound the memory
+ * of cached lines.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef SPILLFILE_HEADER
+#define SPILLFILE_HEADER
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "keytable.h"
+#include "stringref.h"
+
+/*!
+ * Anonymous temporary file to which rows are appended and then read back in
+ * order. Each row is stored already split: the line text followed by any
+ * values not contained in it, and a table of key ids and value offsets into
+ * the text. Reading a row therefore does not tokenize the line again. Key ids
+ * are only valid within the process, like the file itself.
+ */
+class SpillFile
+{
+protected:
+    //! temporary file, unlinked after creation
+    FILE* m_file;
+
+    //! number of rows written
+    size_t m_rows;
+
+    //! number of bytes written
+    size_t m_bytes;
+
+    //! row text and field table buffers
+    std::string m_text, m_table;
+
+    //! non-copyable: file is closed in destructor
+    SpillFile(const SpillFile&);
+
+    //! non-copyable: file is closed in destructor
+    SpillFile& operator = (const SpillFile&);
+
+    //! write data to the file, throws on errors
+    void write_data(const void* data, size_t size);
+
+    //! read data from the file, returns false at the end, throws on errors
+    bool read_data(void* data, size_t size);
+
+public:
+    //! create temporary file in $TMPDIR or /tmp, throws on errors.
+    SpillFile();
+
+    //! close and thereby remove the file
+    ~SpillFile();
+
+    //! number of rows written
+    size_t rows() const
+    {
+        return m_rows;
+    }
+
+    //! number of bytes written
+    size_t bytes() const
+    {
+        return m_bytes;
+    }
+
+    //! append a row of line, key ids and values
+    void write(const StringRef& line,
+               const std::vector<KeyTable::id_type>& keys,
+               const std::vector<StringRef>& values);
+
+    //! seek to the first row for reading
+    void rewind();
+
+    //! read the next row, returns false at the end. The line and values
+    //! reference an internal buffer, which is valid until the next call.
+    bool read(StringRef& line,
+              std::vector<KeyTable::id_type>& keys,
+              std::vector<StringRef>& values);
+};
+
+#endif // SPILLFILE_HEADER
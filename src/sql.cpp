@@ -28,6 +28,7 @@
 #include <cstring>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
 SqlQueryImpl::SqlQueryImpl(const std::string& query)
@@ -74,6 +75,32 @@ unsigned int SqlQueryImpl::find_col(const std::string& name) const
     return it->second;
 }
 
+//! Read column col of current row as a double by parsing its text.
+bool SqlQueryImpl::as_double(unsigned int col, double& out) const
+{
+    return parse_double(view(col), out);
+}
+
+//! Read column col of current row as a 64-bit integer by parsing its text.
+bool SqlQueryImpl::as_int64(unsigned int col, int64_t& out) const
+{
+    return parse_int64(view(col), out);
+}
+
+//! Read cell (row,col) as a double by parsing its text.
+bool SqlQueryImpl::as_double(unsigned int row, unsigned int col,
+                             double& out) const
+{
+    return parse_double(view(row, col), out);
+}
+
+//! Read cell (row,col) as a 64-bit integer by parsing its text.
+bool SqlQueryImpl::as_int64(unsigned int row, unsigned int col,
+                            int64_t& out) const
+{
+    return parse_int64(view(row, col), out);
+}
+
 //! Format result as a text table
 std::string SqlQueryImpl::format_texttable()
 {
@@ -93,9 +120,11 @@ std::string SqlQueryImpl::format_texttable()
     {
         for (unsigned int col = 0; col < num_cols(); ++col)
         {
-            width[col] = std::max(width[col], text(row, col).size() );
+            StringRef cell = view(row, col);
+            width[col] = std::max(width[col], cell.size());
 
-            if (is_number[col] && !str_is_double(text(row, col)))
+            double d;
+            if (is_number[col] && cell.size() && !as_double(row, col, d))
                 is_number[col] = false;
         }
     }
@@ -138,7 +167,7 @@ std::string SqlQueryImpl::format_texttable()
             else
                 os << std::left;
 
-            os << text(row, col) << ' ';
+            os << view(row, col).str() << ' ';
         }
         os << '|' << std::endl;
     }
@@ -149,6 +178,118 @@ std::string SqlQueryImpl::format_texttable()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+SqlStatementImpl::SqlStatementImpl(const std::string& query,
+                                   const ptypes_type& types)
+    : m_query(query), m_types(types)
+{
+}
+
+SqlStatementImpl::~SqlStatementImpl()
+{
+}
+
+//! Return query string.
+const std::string& SqlStatementImpl::query() const
+{
+    return m_query;
+}
+
+//! Bind string parameters, execute the statement and reset it.
+void SqlStatementImpl::execute(const std::vector<std::string>& params)
+{
+    execute(std::vector<StringRef>(params.begin(), params.end()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SqlBulkLoadImpl::SqlBulkLoadImpl(const std::string& table, size_t num_cols)
+    : m_table(table), m_num_cols(num_cols)
+{
+}
+
+SqlBulkLoadImpl::~SqlBulkLoadImpl()
+{
+}
+
+//! Append an integer cell to the current row, by default as text.
+void SqlBulkLoadImpl::put_int64(int64_t value)
+{
+    char buffer[32];
+    int len = snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+    put(StringRef(buffer, len));
+}
+
+//! Append a floating point cell to the current row, by default as text with
+//! enough digits to read back the same double.
+void SqlBulkLoadImpl::put_double(double value)
+{
+    char buffer[32];
+    put(StringRef(buffer, format_double(value, buffer)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 SqlDatabase::~SqlDatabase()
 {
 }
+
+//! default: no statement cache.
+void SqlDatabase::stmt_cache_stats(size_t& hits, size_t& misses) const
+{
+    hits = misses = 0;
+}
+
+//! default: no special bulk loading facility, use prepared statements.
+SqlBulkLoad SqlDatabase::bulk_load(const std::string& /* table */,
+                                   const std::vector<std::string>& /* cols */)
+{
+    return SqlBulkLoad();
+}
+
+//! default: no in-memory tables, use regular tables.
+SqlBulkLoad SqlDatabase::columnar_table(const std::string& /* table */,
+                                        const FieldSet& /* fields */)
+{
+    return SqlBulkLoad();
+}
+
+//! default: no settings to change for bulk loading.
+void SqlDatabase::bulk_profile(bool /* enable */)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! enable the bulk loading profile of the database
+SqlBulkProfile::SqlBulkProfile(SqlDatabase& db)
+    : m_db(&db)
+{
+    m_db->bulk_profile(true);
+}
+
+//! restore the previous settings, ignoring errors
+SqlBulkProfile::~SqlBulkProfile()
+{
+    try {
+        restore();
+    }
+    catch (std::runtime_error& e) {
+        OUT("Error restoring database settings: " << e.what());
+    }
+}
+
+//! restore the previous settings now, throws on errors.
+void SqlBulkProfile::restore()
+{
+    if (!m_db) return;
+
+    SqlDatabase* db = m_db;
+    m_db = NULL;
+    db->bulk_profile(false);
+}
+
+//! keep the bulk loading profile after leaving the scope
+void SqlBulkProfile::keep()
+{
+    m_db = NULL;
+}
@@ -27,9 +27,16 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <utility>
 
 #include <boost/shared_ptr.hpp>
 
+#include <stdint.h>
+
+#include "lrucache.h"
+#include "numparse.h"
+#include "stringref.h"
+
 class SqlQueryImpl
 {
 protected:
@@ -85,7 +92,22 @@ public:
     virtual bool isNULL(unsigned int col) const = 0;
 
     //! Return text representation of column col of current row.
-    virtual std::string text(unsigned int col) const = 0;
+    std::string text(unsigned int col) const
+    {
+        return view(col).str();
+    }
+
+    //! Return reference to the text representation of column col of current
+    //! row, which is valid until the next step().
+    virtual StringRef view(unsigned int col) const = 0;
+
+    //! Read column col of current row as a double, returns false if it is not
+    //! numeric. The default parses the text representation.
+    virtual bool as_double(unsigned int col, double& out) const;
+
+    //! Read column col of current row as a 64-bit integer, returns false if it
+    //! is not an integer. The default parses the text representation.
+    virtual bool as_int64(unsigned int col, int64_t& out) const;
 
     // *** Complete Result Caching ***
 
@@ -96,7 +118,21 @@ public:
     virtual bool isNULL(unsigned int row, unsigned int col) const = 0;
 
     //! Return text representation of cell (row,col).
-    virtual std::string text(unsigned int row, unsigned int col) const = 0;
+    std::string text(unsigned int row, unsigned int col) const
+    {
+        return view(row, col).str();
+    }
+
+    //! Return reference to the text representation of cell (row,col), which
+    //! is valid as long as the result.
+    virtual StringRef view(unsigned int row, unsigned int col) const = 0;
+
+    //! Read cell (row,col) as a double, returns false if it is not numeric.
+    virtual bool as_double(unsigned int row, unsigned int col, double& out) const;
+
+    //! Read cell (row,col) as a 64-bit integer, returns false if it is not an
+    //! integer.
+    virtual bool as_int64(unsigned int row, unsigned int col, int64_t& out) const;
 
     // *** TEXTTABLE formatting ***
 
@@ -107,6 +143,133 @@ public:
 //! shared pointer to an SqlQuery implementation
 typedef boost::shared_ptr<SqlQueryImpl> SqlQuery;
 
+//! Prepared SQL statement without result, which is executed repeatedly with
+//! different placeholder parameters.
+class SqlStatementImpl
+{
+public:
+    //! Type of a placeholder parameter. Parameters of numeric type are bound
+    //! as native numbers if their text parses as one, otherwise as text.
+    //! Parameters of native type are the eight bytes of an int64_t or double
+    //! in host byte order.
+    enum param_type {
+        PARAM_TEXT, PARAM_INTEGER, PARAM_DOUBLE,
+        PARAM_NATIVE_INTEGER, PARAM_NATIVE_DOUBLE
+    };
+
+    //! List of parameter types, missing ones are PARAM_TEXT.
+    typedef std::vector<param_type> ptypes_type;
+
+protected:
+    //! Saved query string
+    std::string m_query;
+
+    //! Types of parameters
+    ptypes_type m_types;
+
+    //! Return type of parameter i
+    param_type ptype(size_t i) const
+    {
+        return i < m_types.size() ? m_types[i] : PARAM_TEXT;
+    }
+
+    //! Return parameter i as integer, if it has integer type and its text
+    //! parses as one.
+    bool param_int64(size_t i, const StringRef& param, int64_t& out) const
+    {
+        switch (ptype(i))
+        {
+        case PARAM_INTEGER:
+            return parse_int64(param, out);
+        case PARAM_NATIVE_INTEGER:
+            memcpy(&out, param.data(), sizeof(out));
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    //! Return parameter i as double, if it has floating point type and its
+    //! text parses as one.
+    bool param_double(size_t i, const StringRef& param, double& out) const
+    {
+        switch (ptype(i))
+        {
+        case PARAM_DOUBLE:
+            return parse_double(param, out);
+        case PARAM_NATIVE_DOUBLE:
+            memcpy(&out, param.data(), sizeof(out));
+            return true;
+        default:
+            return false;
+        }
+    }
+
+public:
+
+    //! Prepare a SQL statement, throws on errors.
+    SqlStatementImpl(const std::string& query, const ptypes_type& types);
+
+    //! Free statement
+    virtual ~SqlStatementImpl();
+
+    //! Return query string.
+    const std::string& query() const;
+
+    //! Bind parameters, execute the statement and reset it for the next
+    //! execution, throws on errors. The parameters are only referenced during
+    //! the call.
+    virtual void execute(const std::vector<StringRef>& params) = 0;
+
+    //! Bind string parameters, execute the statement and reset it.
+    void execute(const std::vector<std::string>& params);
+};
+
+//! shared pointer to an SqlStatement implementation
+typedef boost::shared_ptr<SqlStatementImpl> SqlStatement;
+
+//! Bulk loader which streams rows of a fixed column list into a table using
+//! the fastest loading facility of the database.
+class SqlBulkLoadImpl
+{
+protected:
+    //! target table
+    std::string m_table;
+
+    //! number of columns in each row
+    size_t m_num_cols;
+
+public:
+
+    //! Start bulk loading into the given columns of table.
+    SqlBulkLoadImpl(const std::string& table, size_t num_cols);
+
+    //! Free bulk loader, aborts loading if not finished.
+    virtual ~SqlBulkLoadImpl();
+
+    //! Append a text cell to the current row.
+    virtual void put(const StringRef& value) = 0;
+
+    //! Append a NULL cell to the current row.
+    virtual void put_null() = 0;
+
+    //! Append an integer cell to the current row, by default as text.
+    virtual void put_int64(int64_t value);
+
+    //! Append a floating point cell to the current row, by default as text
+    //! with enough digits to read back the same double.
+    virtual void put_double(double value);
+
+    //! Finish the current row.
+    virtual void end_row() = 0;
+
+    //! Flush all remaining rows into the table, throws on errors.
+    virtual void finish() = 0;
+};
+
+//! shared pointer to an SqlBulkLoad implementation
+typedef boost::shared_ptr<SqlBulkLoadImpl> SqlBulkLoad;
+
 //! abstract SqlDatabase class, provides mainly queries.
 class SqlDatabase
 {
@@ -140,14 +303,135 @@ public:
     virtual SqlQuery query(const std::string& query,
                            const std::vector<std::string>& params) = 0;
 
+    //! prepare statement object for repeated execution with placeholders of
+    //! the given types.
+    virtual SqlStatement prepare(
+        const std::string& query,
+        const SqlStatementImpl::ptypes_type& types =
+            SqlStatementImpl::ptypes_type()) = 0;
+
+    //! start bulk loading rows into the columns of table, returns an empty
+    //! pointer if the database has no special bulk loading facility.
+    virtual SqlBulkLoad bulk_load(const std::string& table,
+                                  const std::vector<std::string>& cols);
+
     //! test if a table exists in the database
     virtual bool exist_table(const std::string& table) = 0;
 
+    //! list of (name, SQL type) pairs of table columns
+    typedef std::vector<std::pair<std::string, std::string> > columns_type;
+
+    //! return the columns of an existing table in their order
+    virtual columns_type table_columns(const std::string& table) = 0;
+
+    //! create a temporary read-only table of the fields, whose rows are kept
+    //! in typed in-memory columns. Returns a bulk loader filling the table,
+    //! or an empty pointer if the database does not support this.
+    virtual SqlBulkLoad columnar_table(const std::string& table,
+                                       const class FieldSet& fields);
+
+    //! switch connection to settings for fast bulk loading, which sacrifice
+    //! durability, or restore the previous settings.
+    virtual void bulk_profile(bool enable);
+
     //! return last error message string
     virtual const char* errmsg() const = 0;
+
+    //! return number of queries which reused a cached prepared statement, and
+    //! which had to prepare one.
+    virtual void stmt_cache_stats(size_t& hits, size_t& misses) const;
+};
+
+//! Switches a database to its bulk loading profile while in scope, and
+//! restores the previous settings when leaving it, also by an exception.
+class SqlBulkProfile
+{
+protected:
+    //! database to restore, or NULL if already restored or kept
+    SqlDatabase* m_db;
+
+public:
+    //! enable the bulk loading profile of the database
+    explicit SqlBulkProfile(SqlDatabase& db);
+
+    //! restore the previous settings, ignoring errors
+    ~SqlBulkProfile();
+
+    //! restore the previous settings now, throws on errors.
+    void restore();
+
+    //! keep the bulk loading profile after leaving the scope
+    void keep();
 };
 
-//! Cache complete data from SQL results
+/*!
+ * Cache of prepared statement handles of queries, keyed by SQL text. A query
+ * takes the handle out of the cache while it runs and puts it back reset
+ * afterwards, hence identical queries may also run nested, each with its own
+ * handle. Handles free their statement when the last reference is dropped.
+ */
+template <typename Handle>
+class SqlStatementCache
+{
+public:
+    //! reference counted statement handle
+    typedef boost::shared_ptr<Handle> handle_type;
+
+protected:
+    //! cached idle statements
+    LruCache<std::string, handle_type> m_cache;
+
+    //! number of queries which reused or prepared a statement
+    size_t m_hits, m_misses;
+
+public:
+    //! construct empty cache holding at most capacity statements
+    explicit SqlStatementCache(size_t capacity = 64)
+        : m_cache(capacity), m_hits(0), m_misses(0)
+    {
+    }
+
+    //! take the statement of query out of the cache, or return an empty
+    //! handle if the query has to be prepared.
+    handle_type take(const std::string& query)
+    {
+        handle_type* cached = m_cache.find(query);
+
+        if (!cached) {
+            ++m_misses;
+            return handle_type();
+        }
+
+        ++m_hits;
+        handle_type handle = *cached;
+        m_cache.erase(query);
+        return handle;
+    }
+
+    //! put the reset statement of query back into the cache. If another one
+    //! was put back meanwhile, the handle is simply dropped.
+    void put(const std::string& query, const handle_type& handle)
+    {
+        if (!m_cache.find(query))
+            m_cache.insert(query, handle);
+    }
+
+    //! free all cached statements
+    void clear()
+    {
+        m_cache.clear();
+    }
+
+    //! number of queries which reused a cached statement
+    size_t hits() const { return m_hits; }
+
+    //! number of queries which had to prepare a statement
+    size_t misses() const { return m_misses; }
+};
+
+//! Cache complete data from SQL results. The cache is column-major: each
+//! column keeps its cells' characters back-to-back in one buffer with an
+//! offsets array, a NULL bitmap, and the parsed numbers of numeric cells.
 class SqlDataCache
 {
 protected:
@@ -155,19 +439,35 @@ protected:
     //! complete table read
     bool m_complete;
 
-    //! type of each row
-    typedef std::vector< std::pair<bool,std::string> > row_type;
+    //! number of cached rows
+    size_t m_rows;
+
+    //! cached data of one column
+    struct Column
+    {
+        //! characters of all cells, back-to-back
+        std::string chars;
+
+        //! begin of each cell in chars, plus the end of the last cell
+        std::vector<size_t> offsets;
 
-    //! type of the whole table
-    typedef std::vector<row_type> table_type;
+        //! cell is NULL
+        std::vector<bool> null;
 
-    //! cache table
-    table_type m_table;
+        //! cell has a numeric value
+        std::vector<bool> numeric;
+
+        //! numeric values, empty if the column has no numeric cells
+        std::vector<double> number;
+    };
+
+    //! cached columns
+    std::vector<Column> m_columns;
 
 protected:
     //! simple initializer
     SqlDataCache()
-        : m_complete(false)
+        : m_complete(false), m_rows(0)
     {
     }
 
@@ -176,19 +476,45 @@ protected:
     {
         if (m_complete) return;
 
+        m_columns.resize(sql.num_cols());
+
+        for (size_t col = 0; col < m_columns.size(); ++col)
+            m_columns[col].offsets.assign(1, 0);
+
         while (sql.step())
         {
-            row_type row;
-
-            for (size_t col = 0; col < sql.num_cols(); ++col)
+            for (size_t col = 0; col < m_columns.size(); ++col)
             {
-                if (sql.isNULL(col))
-                    row.push_back( std::make_pair(true, std::string()) );
-                else
-                    row.push_back( std::make_pair(false, sql.text(col)) );
+                Column& c = m_columns[col];
+                double d = 0;
+
+                if (sql.isNULL(col)) {
+                    c.null.push_back(true);
+                    c.numeric.push_back(false);
+                }
+                else {
+                    StringRef view = sql.view(col);
+                    c.chars.append(view.data(), view.size());
+                    c.null.push_back(false);
+                    c.numeric.push_back(sql.as_double(col, d));
+                }
+
+                c.offsets.push_back(c.chars.size());
+
+                if (c.numeric.back()) {
+                    c.number.resize(m_rows, 0.0);
+                    c.number.push_back(d);
+                }
             }
 
-            m_table.push_back(row);
+            ++m_rows;
+        }
+
+        // pad number columns of trailing non-numeric cells
+        for (size_t col = 0; col < m_columns.size(); ++col)
+        {
+            if (!m_columns[col].number.empty())
+                m_columns[col].number.resize(m_rows, 0.0);
         }
 
         m_complete = true;
@@ -203,25 +529,40 @@ protected:
     //! Return number of cached rows
     size_t num_rows() const
     {
-        return m_table.size();
+        return m_rows;
     }
 
     //! Returns true if cell (row,col) is NULL.
     bool isNULL(unsigned int row, unsigned int col) const
     {
         assert(m_complete);
-        assert(row < m_table.size());
-        assert(col < m_table[row].size());
-        return m_table[row][col].first;
+        assert(row < m_rows);
+        assert(col < m_columns.size());
+        return m_columns[col].null[row];
     }
 
-    //! Return text representation of cell (row,col).
-    std::string text(unsigned int row, unsigned int col) const
+    //! Return reference to the text representation of cell (row,col).
+    StringRef view(unsigned int row, unsigned int col) const
+    {
+        assert(m_complete);
+        assert(row < m_rows);
+        assert(col < m_columns.size());
+        const Column& c = m_columns[col];
+        return StringRef(c.chars.data() + c.offsets[row],
+                         c.offsets[row + 1] - c.offsets[row]);
+    }
+
+    //! Read cell (row,col) as a double from the parsed numbers, returns false
+    //! if it is not numeric.
+    bool as_double(unsigned int row, unsigned int col, double& out) const
     {
         assert(m_complete);
-        assert(row < m_table.size());
-        assert(col < m_table[row].size());
-        return m_table[row][col].second.c_str();
+        assert(row < m_rows);
+        assert(col < m_columns.size());
+        const Column& c = m_columns[col];
+        if (!c.numeric[row]) return false;
+        out = c.number[row];
+        return true;
     }
 };
 
@@ -22,6 +22,7 @@
  *****************************************************************************/
 
 #include "sqlite.h"
+#include "columnstore.h"
 #include "common.h"
 #include "strtools.h"
 
@@ -35,31 +36,8 @@ SQLiteQuery::SQLiteQuery(class SQLiteDatabase& db, const std::string& query)
     : SqlQueryImpl(query),
       m_db(db)
 {
-    const char* zTail = 0;
-
-    int rc = sqlite3_prepare_v2(m_db.m_db, query.c_str(), query.size()+1,
-                                &m_stmt, &zTail);
-    if (rc != SQLITE_OK)
-    {
-        OUT_THROW("SQL query parse " << query << "\n" <<
-                  "Failed at " << zTail << " : " << m_db.errmsg());
-    }
-
-    rc = sqlite3_step(m_stmt);
-
-    if (rc == SQLITE_ROW)
-    {
-        m_row = -1;
-    }
-    else if (rc == SQLITE_DONE)
-    {
-        m_row = -2;
-    }
-    else
-    {
-        OUT_THROW("SQL query " << query << "\n" <<
-                  "Failed : " << m_db.errmsg());
-    }
+    prepare();
+    first_step();
 }
 
 //! Execute a SQL query with parameters, throws on errors.
@@ -68,15 +46,7 @@ SQLiteQuery::SQLiteQuery(class SQLiteDatabase& db, const std::string& query,
     : SqlQueryImpl(query),
       m_db(db)
 {
-    const char* zTail = 0;
-
-    int rc = sqlite3_prepare_v2(m_db.m_db, query.c_str(), query.size()+1,
-                                &m_stmt, &zTail);
-    if (rc != SQLITE_OK)
-    {
-        OUT_THROW("SQL query parse " << query << "\n" <<
-                  "Failed at " << zTail << " : " << m_db.errmsg());
-    }
+    prepare();
 
     for (size_t i = 0; i < params.size(); ++i)
     {
@@ -84,7 +54,43 @@ SQLiteQuery::SQLiteQuery(class SQLiteDatabase& db, const std::string& query,
                           params[i].data(), params[i].size(), NULL);
     }
 
-    rc = sqlite3_step(m_stmt);
+    first_step();
+}
+
+//! Take the statement from the database's cache or prepare it, throws on
+//! errors.
+void SQLiteQuery::prepare()
+{
+    m_handle = m_db.m_stmt_cache.take(query());
+
+    if (!m_handle)
+    {
+        const char* zTail = 0;
+        sqlite3_stmt* stmt;
+
+#if SQLITE_VERSION_NUMBER >= 3020000
+        int rc = sqlite3_prepare_v3(m_db.m_db, query().c_str(), query().size()+1,
+                                    SQLITE_PREPARE_PERSISTENT, &stmt, &zTail);
+#else
+        int rc = sqlite3_prepare_v2(m_db.m_db, query().c_str(), query().size()+1,
+                                    &stmt, &zTail);
+#endif
+        if (rc != SQLITE_OK)
+        {
+            OUT_THROW("SQL query parse " << query() << "\n" <<
+                      "Failed at " << zTail << " : " << m_db.errmsg());
+        }
+
+        m_handle = handle_type(stmt, sqlite3_finalize);
+    }
+
+    m_stmt = m_handle.get();
+}
+
+//! Execute statement and fetch the first row, throws on errors.
+void SQLiteQuery::first_step()
+{
+    int rc = sqlite3_step(m_stmt);
 
     if (rc == SQLITE_ROW)
     {
@@ -96,7 +102,7 @@ SQLiteQuery::SQLiteQuery(class SQLiteDatabase& db, const std::string& query,
     }
     else
     {
-        OUT_THROW("SQL query " << query << "\n" <<
+        OUT_THROW("SQL query " << query() << "\n" <<
                   "Failed : " << m_db.errmsg());
     }
 }
@@ -104,7 +110,11 @@ SQLiteQuery::SQLiteQuery(class SQLiteDatabase& db, const std::string& query,
 //! Free result
 SQLiteQuery::~SQLiteQuery()
 {
-    sqlite3_finalize(m_stmt);
+    // reset the statement and keep it for the next identical query
+    sqlite3_reset(m_stmt);
+    sqlite3_clear_bindings(m_stmt);
+
+    m_db.m_stmt_cache.put(query(), m_handle);
 }
 
 //! Return number of rows in result, throws if no tuples.
@@ -171,14 +181,48 @@ bool SQLiteQuery::isNULL(unsigned int col) const
     return sqlite3_column_type(m_stmt, col) == SQLITE_NULL;
 }
 
-//! Return text representation of column col of current row.
-std::string SQLiteQuery::text(unsigned int col) const
+//! Return reference to the text representation of column col of current row.
+StringRef SQLiteQuery::view(unsigned int col) const
 {
     assert(col < num_cols());
 
     const unsigned char* data = sqlite3_column_text(m_stmt, col);
     size_t size = sqlite3_column_bytes(m_stmt, col);
-    return std::string((const char*)data, size);
+    return StringRef(data ? (const char*)data : "", size);
+}
+
+//! Read column col of current row as a double, natively if it is stored as a
+//! number.
+bool SQLiteQuery::as_double(unsigned int col, double& out) const
+{
+    assert(col < num_cols());
+
+    int type = sqlite3_column_type(m_stmt, col);
+    if (type == SQLITE_INTEGER || type == SQLITE_FLOAT) {
+        out = sqlite3_column_double(m_stmt, col);
+        return true;
+    }
+    else if (type == SQLITE_TEXT) {
+        return SqlQueryImpl::as_double(col, out);
+    }
+    return false;
+}
+
+//! Read column col of current row as a 64-bit integer, natively if it is
+//! stored as an integer.
+bool SQLiteQuery::as_int64(unsigned int col, int64_t& out) const
+{
+    assert(col < num_cols());
+
+    int type = sqlite3_column_type(m_stmt, col);
+    if (type == SQLITE_INTEGER) {
+        out = sqlite3_column_int64(m_stmt, col);
+        return true;
+    }
+    else if (type == SQLITE_TEXT || type == SQLITE_FLOAT) {
+        return SqlQueryImpl::as_int64(col, out);
+    }
+    return false;
 }
 
 //! read complete result into memory
@@ -193,10 +237,77 @@ bool SQLiteQuery::isNULL(unsigned int row, unsigned int col) const
     return SqlDataCache::isNULL(row, col);
 }
 
-//! Return text representation of cell (row,col).
-std::string SQLiteQuery::text(unsigned int row, unsigned int col) const
+//! Return reference to the text representation of cell (row,col).
+StringRef SQLiteQuery::view(unsigned int row, unsigned int col) const
+{
+    return SqlDataCache::view(row, col);
+}
+
+//! Read cell (row,col) as a double from the cache.
+bool SQLiteQuery::as_double(unsigned int row, unsigned int col, double& out) const
 {
-    return SqlDataCache::text(row, col);
+    return SqlDataCache::as_double(row, col, out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//! Prepare a SQL statement, throws on errors.
+SQLiteStatement::SQLiteStatement(class SQLiteDatabase& db,
+                                 const std::string& query,
+                                 const ptypes_type& types)
+    : SqlStatementImpl(query, types),
+      m_db(db)
+{
+    const char* zTail = 0;
+
+    int rc = sqlite3_prepare_v2(m_db.m_db, query.c_str(), query.size()+1,
+                                &m_stmt, &zTail);
+    if (rc != SQLITE_OK)
+    {
+        OUT_THROW("SQL query parse " << query << "\n" <<
+                  "Failed at " << zTail << " : " << m_db.errmsg());
+    }
+}
+
+//! Free statement
+SQLiteStatement::~SQLiteStatement()
+{
+    sqlite3_finalize(m_stmt);
+}
+
+//! Bind parameters, execute the statement and reset it, throws on errors.
+void SQLiteStatement::execute(const std::vector<StringRef>& params)
+{
+    // parameters are only referenced until the bindings are cleared below.
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        int64_t ival;
+        double dval;
+
+        if (param_int64(i, params[i], ival))
+            sqlite3_bind_int64(m_stmt, i+1, ival);
+        else if (param_double(i, params[i], dval))
+            sqlite3_bind_double(m_stmt, i+1, dval);
+        else
+            sqlite3_bind_text(m_stmt, i+1,
+                              params[i].data(), params[i].size(), SQLITE_STATIC);
+    }
+
+    int rc = sqlite3_step(m_stmt);
+
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+    {
+        std::string errmsg = m_db.errmsg();
+
+        sqlite3_reset(m_stmt);
+        sqlite3_clear_bindings(m_stmt);
+
+        OUT_THROW("SQL query " << query() << "\n" <<
+                  "Failed : " << errmsg);
+    }
+
+    sqlite3_reset(m_stmt);
+    sqlite3_clear_bindings(m_stmt);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -222,17 +333,30 @@ bool SQLiteDatabase::initialize(const std::string& params)
     // register additional math functions
     RegisterExtensionFunctions(m_db);
 
+    // register virtual tables of in-memory columns
+    m_column_stores.register_module(m_db);
+
     return true;
 }
 
 //! destructor to free connection
 SQLiteDatabase::~SQLiteDatabase()
 {
+    // finalize cached statements before closing
+    m_stmt_cache.clear();
+
     if (m_db) {
         sqlite3_close(m_db);
     }
 }
 
+//! return hits and misses of the statement cache
+void SQLiteDatabase::stmt_cache_stats(size_t& hits, size_t& misses) const
+{
+    hits = m_stmt_cache.hits();
+    misses = m_stmt_cache.misses();
+}
+
 //! return type of SQL database
 SQLiteDatabase::db_type SQLiteDatabase::type() const
 {
@@ -280,6 +404,13 @@ SqlQuery SQLiteDatabase::query(const std::string& query,
     return SqlQuery( new SQLiteQuery(*this, query, params) );
 }
 
+//! prepare statement object for repeated execution with placeholders
+SqlStatement SQLiteDatabase::prepare(const std::string& query,
+                                        const SqlStatementImpl::ptypes_type& types)
+{
+    return SqlStatement( new SQLiteStatement(*this, query, types) );
+}
+
 //! test if a table exists in the database
 bool SQLiteDatabase::exist_table(const std::string& table)
 {
@@ -287,7 +418,9 @@ bool SQLiteDatabase::exist_table(const std::string& table)
     params.push_back(table);
 
     SQLiteQuery sql(*this,
-                    "SELECT COUNT(*) FROM sqlite_master "
+                    "SELECT COUNT(*) FROM ("
+                    "SELECT name, type FROM sqlite_master UNION ALL "
+                    "SELECT name, type FROM sqlite_temp_master) "
                     "WHERE type='table' AND name = $1",
                     params);
 
@@ -299,6 +432,88 @@ bool SQLiteDatabase::exist_table(const std::string& table)
     return (sql.text(0) != "0");
 }
 
+//! return the columns of an existing table in their order
+SqlDatabase::columns_type SQLiteDatabase::table_columns(const std::string& table)
+{
+    SQLiteQuery sql(*this, "PRAGMA table_info(" + quote_field(table) + ")");
+
+    // columns: cid, name, type, notnull, dflt_value, pk
+    columns_type cols;
+    while (sql.step())
+        cols.push_back(std::make_pair(sql.text(1), sql.text(2)));
+
+    return cols;
+}
+
+//! create a virtual table of the fields stored in a ColumnStore
+SqlBulkLoad SQLiteDatabase::columnar_table(const std::string& table,
+                                           const FieldSet& fields)
+{
+    boost::shared_ptr<ColumnStore> store(new ColumnStore(fields));
+    std::string id = m_column_stores.publish(store);
+
+    try {
+        execute("CREATE VIRTUAL TABLE temp." + quote_field(table) +
+                " USING sqlplot_columns(" + id + ")");
+    }
+    catch (std::runtime_error&) {
+        m_column_stores.unpublish(id);
+        throw;
+    }
+
+    return SqlBulkLoad(new ColumnStoreLoad(table, store));
+}
+
+//! switch to pragmas for fast bulk loading, or restore previous values. The
+//! profile keeps the journal in memory, so transactions can still be rolled
+//! back, but skips all syncs to disk. temp_store is not changed, since that
+//! drops all existing temporary tables.
+void SQLiteDatabase::bulk_profile(bool enable)
+{
+    static const char* profile[][2] = {
+        { "journal_mode", "MEMORY" },
+        { "synchronous", "OFF" },
+        { "cache_size", "-262144" },
+        { "locking_mode", "EXCLUSIVE" },
+    };
+
+    if (enable)
+    {
+        if (!m_saved_pragmas.empty()) return;
+
+        for (size_t i = 0; i < sizeof(profile) / sizeof(profile[0]); ++i)
+        {
+            std::string value;
+            {
+                SQLiteQuery sql(*this, std::string("PRAGMA ") + profile[i][0]);
+                if (!sql.step()) continue;
+                value = sql.text(0);
+            }
+
+            // write-ahead logging is fast enough without syncs
+            if (value == "wal") continue;
+
+            m_saved_pragmas.push_back(std::make_pair(profile[i][0], value));
+
+            execute(std::string("PRAGMA ") + profile[i][0] + " = " + profile[i][1]);
+        }
+    }
+    else
+    {
+        if (m_saved_pragmas.empty()) return;
+
+        for (size_t i = m_saved_pragmas.size(); i != 0; --i)
+        {
+            execute("PRAGMA " + m_saved_pragmas[i-1].first + " = " +
+                    m_saved_pragmas[i-1].second);
+        }
+        m_saved_pragmas.clear();
+
+        // an exclusive lock is released only on the next access
+        execute("SELECT COUNT(*) FROM sqlite_master");
+    }
+}
+
 //! return last error message string
 const char* SQLiteDatabase::errmsg() const
 {
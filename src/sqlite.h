@@ -26,6 +26,9 @@
 
 #include <sqlite3.h>
 
+#include <utility>
+
+#include "columnstore.h"
 #include "sql.h"
 
 class SQLiteQuery : public SqlQueryImpl, protected SqlDataCache
@@ -34,12 +37,25 @@ protected:
     //! SQLite database connection
     class SQLiteDatabase& m_db;
 
+    //! type of reference counted statement handle
+    typedef SqlStatementCache<sqlite3_stmt>::handle_type handle_type;
+
+    //! SQLite statement handle, taken from the statement cache
+    handle_type m_handle;
+
     //! SQLite statement object
     sqlite3_stmt* m_stmt;
 
     //! Current result row
     int m_row;
 
+    //! Take the statement from the database's cache or prepare it, throws on
+    //! errors.
+    void prepare();
+
+    //! Execute statement and fetch the first row, throws on errors.
+    void first_step();
+
 public:
 
     //! Execute a SQL query without placeholders, throws on errors.
@@ -74,8 +90,17 @@ public:
     //! Returns true if cell (current_row,col) is NULL.
     bool isNULL(unsigned int col) const;
 
-    //! Return text representation of column col of current row.
-    std::string text(unsigned int col) const;
+    //! Return reference to the text representation of column col of current
+    //! row.
+    StringRef view(unsigned int col) const;
+
+    //! Read column col of current row as a double, natively if it is stored
+    //! as a number.
+    bool as_double(unsigned int col, double& out) const;
+
+    //! Read column col of current row as a 64-bit integer, natively if it is
+    //! stored as an integer.
+    bool as_int64(unsigned int col, int64_t& out) const;
 
     // *** Complete Result Caching ***
 
@@ -85,8 +110,37 @@ public:
     //! Returns true if cell (row,col) is NULL.
     bool isNULL(unsigned int row, unsigned int col) const;
 
-    //! Return text representation of cell (row,col).
-    std::string text(unsigned int row, unsigned int col) const;
+    //! Return reference to the text representation of cell (row,col).
+    StringRef view(unsigned int row, unsigned int col) const;
+
+    //! Read cell (row,col) as a double from the cache.
+    bool as_double(unsigned int row, unsigned int col, double& out) const;
+
+    //! cached cells are parsed by the default implementation
+    using SqlQueryImpl::as_int64;
+};
+
+//! SQLite prepared statement, which is reset after each execution
+class SQLiteStatement : public SqlStatementImpl
+{
+protected:
+    //! SQLite database connection
+    class SQLiteDatabase& m_db;
+
+    //! SQLite statement object
+    sqlite3_stmt* m_stmt;
+
+public:
+
+    //! Prepare a SQL statement, throws on errors.
+    SQLiteStatement(class SQLiteDatabase& db, const std::string& query,
+                        const ptypes_type& types);
+
+    //! Free statement
+    ~SQLiteStatement();
+
+    //! Bind parameters, execute the statement and reset it, throws on errors.
+    void execute(const std::vector<StringRef>& params);
 };
 
 //! SQLite database connection
@@ -96,8 +150,18 @@ protected:
     //! database connection
     sqlite3* m_db;
 
+    //! previous values of pragmas changed by bulk_profile()
+    std::vector<std::pair<std::string, std::string> > m_saved_pragmas;
+
+    //! idle prepared statements of queries
+    SqlStatementCache<sqlite3_stmt> m_stmt_cache;
+
+    //! stores of the in-memory column tables of this connection
+    ColumnStoreRegistry m_column_stores;
+
     //! for access to database connection
     friend class SQLiteQuery;
+    friend class SQLiteStatement;
 
 public:
     //! virtual destructor to free connection
@@ -125,11 +189,31 @@ public:
     virtual SqlQuery query(const std::string& query,
                            const std::vector<std::string>& params);
 
+    //! prepare statement object for repeated execution with placeholders of
+    //! the given types.
+    virtual SqlStatement prepare(
+        const std::string& query,
+        const SqlStatementImpl::ptypes_type& types =
+            SqlStatementImpl::ptypes_type());
+
     //! test if a table exists in the database
     virtual bool exist_table(const std::string& table);
 
+    //! return the columns of an existing table in their order
+    virtual columns_type table_columns(const std::string& table);
+
+    //! create a virtual table of the fields stored in a ColumnStore
+    virtual SqlBulkLoad columnar_table(const std::string& table,
+                                       const class FieldSet& fields);
+
+    //! switch to pragmas for fast bulk loading, or restore previous values.
+    virtual void bulk_profile(bool enable);
+
     //! return last error message string
     const char* errmsg() const;
+
+    //! return hits and misses of the statement cache
+    virtual void stmt_cache_stats(size_t& hits, size_t& misses) const;
 };
 
 #endif // SQLITE_HEADER
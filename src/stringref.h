@@ -0,0 +1,232 @@
+/******************************************************************************
+ * src/stringref.h
+ *
+ * Non-owning reference to a character range, and an arena which keeps
+ * appended strings at stable addresses.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef STRINGREF_HEADER
+#define STRINGREF_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//! Non-owning reference to a character range, which must outlive the object.
+class StringRef
+{
+protected:
+    //! first character
+    const char* m_data;
+
+    //! number of characters
+    size_t m_size;
+
+public:
+    //! constant iterator is a plain pointer
+    typedef const char* const_iterator;
+
+    //! empty reference
+    StringRef()
+        : m_data(""), m_size(0)
+    {
+    }
+
+    //! reference to data of given size
+    StringRef(const char* data, size_t size)
+        : m_data(data), m_size(size)
+    {
+    }
+
+    //! reference to a zero-terminated string
+    StringRef(const char* str)
+        : m_data(str), m_size(strlen(str))
+    {
+    }
+
+    //! reference to the contents of a std::string
+    StringRef(const std::string& str)
+        : m_data(str.data()), m_size(str.size())
+    {
+    }
+
+    //! first character
+    const char* data() const { return m_data; }
+
+    //! number of characters
+    size_t size() const { return m_size; }
+
+    //! true if the range is empty
+    bool empty() const { return m_size == 0; }
+
+    //! iterator to first character
+    const_iterator begin() const { return m_data; }
+
+    //! iterator beyond last character
+    const_iterator end() const { return m_data + m_size; }
+
+    //! return character i
+    char operator[] (size_t i) const
+    {
+        assert(i < m_size);
+        return m_data[i];
+    }
+
+    //! copy characters into a std::string
+    std::string str() const
+    {
+        return std::string(m_data, m_size);
+    }
+
+    //! reference to characters [pos, pos+len)
+    StringRef substr(size_t pos, size_t len = std::string::npos) const
+    {
+        assert(pos <= m_size);
+        return StringRef(m_data + pos, std::min(len, m_size - pos));
+    }
+
+    //! return position of first ch or std::string::npos
+    size_t find(char ch, size_t pos = 0) const
+    {
+        if (pos >= m_size) return std::string::npos;
+        const void* p = memchr(m_data + pos, ch, m_size - pos);
+        return p ? (const char*)p - m_data : std::string::npos;
+    }
+
+    //! test if the range starts with match
+    bool starts_with(const StringRef& match) const
+    {
+        return m_size >= match.m_size &&
+               memcmp(m_data, match.m_data, match.m_size) == 0;
+    }
+
+    //! compare character ranges
+    bool operator == (const StringRef& b) const
+    {
+        return m_size == b.m_size && memcmp(m_data, b.m_data, m_size) == 0;
+    }
+
+    //! compare character ranges
+    bool operator != (const StringRef& b) const
+    {
+        return !operator == (b);
+    }
+
+    //! output characters to a stream
+    friend std::ostream& operator << (std::ostream& os, const StringRef& s)
+    {
+        return os.write(s.m_data, s.m_size);
+    }
+};
+
+//! Append-only storage for strings, which are never moved until the arena is
+//! cleared, hence StringRefs to them stay valid. Moving the arena keeps them
+//! valid as well.
+class StringArena
+{
+protected:
+    //! default size of allocated blocks
+    enum { block_size = 1024 * 1024 };
+
+    //! allocated blocks
+    std::vector< std::unique_ptr<char[]> > m_blocks;
+
+    //! remaining free bytes at the end of the last block
+    char* m_free;
+
+    //! number of free bytes
+    size_t m_free_size;
+
+    //! total bytes stored
+    size_t m_total;
+
+public:
+    //! construct empty arena
+    StringArena()
+        : m_free(NULL), m_free_size(0), m_total(0)
+    {
+    }
+
+    //! move blocks from another arena, which is left empty
+    StringArena(StringArena&& a)
+        : m_blocks(std::move(a.m_blocks)),
+          m_free(a.m_free), m_free_size(a.m_free_size), m_total(a.m_total)
+    {
+        a.m_blocks.clear();
+        a.m_free = NULL, a.m_free_size = 0, a.m_total = 0;
+    }
+
+    //! move blocks from another arena, which is left empty
+    StringArena& operator = (StringArena&& a)
+    {
+        if (this == &a) return *this;
+        m_blocks = std::move(a.m_blocks);
+        m_free = a.m_free, m_free_size = a.m_free_size, m_total = a.m_total;
+        a.m_blocks.clear();
+        a.m_free = NULL, a.m_free_size = 0, a.m_total = 0;
+        return *this;
+    }
+
+    //! copy characters into the arena and return a reference to them
+    StringRef append(const char* data, size_t size)
+    {
+        if (size > m_free_size)
+        {
+            // oversized strings get a block of their own
+            size_t alloc = std::max(size, size_t(block_size));
+            m_blocks.push_back(std::unique_ptr<char[]>(new char[alloc]));
+            m_free = m_blocks.back().get();
+            m_free_size = alloc;
+        }
+
+        char* out = m_free;
+        memcpy(out, data, size);
+        m_free += size, m_free_size -= size;
+        m_total += size;
+
+        return StringRef(out, size);
+    }
+
+    //! copy characters into the arena and return a reference to them
+    StringRef append(const StringRef& str)
+    {
+        return append(str.data(), str.size());
+    }
+
+    //! total number of bytes stored
+    size_t total() const
+    {
+        return m_total;
+    }
+
+    //! release all blocks, invalidating all references.
+    void clear()
+    {
+        m_blocks.clear();
+        m_free = NULL;
+        m_free_size = 0;
+        m_total = 0;
+    }
+};
+
+#endif // STRINGREF_HEADER
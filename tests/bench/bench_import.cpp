@@ -0,0 +1,379 @@
+/******************************************************************************
+ * tests/bench/bench_import.cpp
+ *
+ * Benchmark of IMPORT-DATA: generates a synthetic RESULT log and imports it
+ * into each given database, reporting throughput and the time spent reading,
+ * parsing, detecting types and inserting.
+ *
+ ******************************************************************************
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "importdata.h"
+#include "importtimer.h"
+#include "simpleopt.h"
+#include "sql.h"
+#include "strtools.h"
+
+//! parameters of the synthetic RESULT log
+struct GenParams
+{
+    //! number of RESULT lines
+    size_t rows = 1000000;
+
+    //! number of keys in each line
+    unsigned int keys = 8;
+
+    //! fraction of keys with text values, the others alternate between
+    //! integers and floating point numbers
+    double text_ratio = 0.25;
+
+    //! fraction of lines which are not RESULT lines
+    double noise_ratio = 0.1;
+
+    //! compression suffix: gz, bz2 or xz, empty for none
+    std::string compress;
+
+    //! random seed
+    unsigned int seed = 1;
+};
+
+//! size of the generated log
+struct GenStats
+{
+    //! number of lines, including noise
+    uint64_t lines = 0;
+
+    //! uncompressed bytes
+    uint64_t bytes = 0;
+};
+
+//! write the synthetic log to path and maybe compress it, returns the name of
+//! the final file.
+static std::string
+generate(const GenParams& gp, const std::string& path, GenStats& gs)
+{
+    static const char* words[] = {
+        "merge", "quick", "radix", "heap", "insertion", "shell", "bitonic", "sample"
+    };
+
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f)
+        OUT_THROW("Error writing " << path << ": " << strerror(errno));
+
+    std::mt19937 rng(gp.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    unsigned int numeric = (unsigned int)(gp.keys * (1.0 - gp.text_ratio) + 0.5);
+
+    std::string line;
+    char buffer[64];
+
+    for (size_t row = 0; row < gp.rows; ++row)
+    {
+        // noise lines between results, like progress output of benchmarks
+        while (uniform(rng) < gp.noise_ratio)
+        {
+            line = "progress: step " + to_str(rng() % 100000) +
+                   " of run " + to_str(row) + "\n";
+            fwrite(line.data(), 1, line.size(), f);
+            ++gs.lines, gs.bytes += line.size();
+        }
+
+        line = "RESULT";
+
+        for (unsigned int k = 0; k < gp.keys; ++k)
+        {
+            line += "\tkey" + to_str(k) + "=";
+
+            if (k >= numeric) {
+                line += words[rng() % 8];
+                line += '_' + to_str(rng() % 100);
+            }
+            else if (k % 2 == 0) {
+                line += to_str(rng() % 1000000);
+            }
+            else {
+                snprintf(buffer, sizeof(buffer), "%.6f", uniform(rng) * 1000);
+                line += buffer;
+            }
+        }
+
+        line += '\n';
+        fwrite(line.data(), 1, line.size(), f);
+        ++gs.lines, gs.bytes += line.size();
+    }
+
+    if (fclose(f) != 0)
+        OUT_THROW("Error writing " << path << ": " << strerror(errno));
+
+    if (gp.compress.empty()) return path;
+
+    std::string tool =
+        gp.compress == "gz" ? "gzip" : gp.compress == "bz2" ? "bzip2" : "xz";
+
+    if (system((tool + " -f " + path).c_str()) != 0)
+        OUT_THROW("Error compressing " << path << " with " << tool);
+
+    return path + "." + gp.compress;
+}
+
+//! timings of one import run in seconds
+struct RunTimes
+{
+    double total, parse, detect, insert;
+
+    //! remainder: reading, decompressing, splitting and caching lines. With
+    //! parser threads, it may be hidden by their summed time completely.
+    double read() const
+    {
+        return std::max(0.0, total - parse - detect - insert);
+    }
+};
+
+//! import file into a fresh table of the database and measure the phases
+static RunTimes
+run_import(const std::string& conninfo,
+           const std::vector<std::string>& import_args, const std::string& file)
+{
+    if (!g_db_connect(conninfo))
+        OUT_THROW("Could not connect to database " << conninfo);
+
+    std::vector<std::string> args;
+    args.push_back("import-data");
+    args.insert(args.end(), import_args.begin(), import_args.end());
+    args.push_back("-P");
+    args.push_back("bench_import");
+    args.push_back(file);
+
+    std::vector<char*> argv;
+    for (size_t i = 0; i < args.size(); ++i)
+        argv.push_back(&args[i][0]);
+    argv.push_back(NULL);
+
+    ImportTimer::reset();
+    ImportTimer::enabled = true;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (ImportData().main(args.size(), argv.data()) != EXIT_SUCCESS)
+        OUT_THROW("Import into " << conninfo << " failed.");
+
+    RunTimes rt;
+    rt.total = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    ImportTimer::enabled = false;
+
+    rt.parse = ImportTimer::seconds(ImportTimer::PARSE);
+    rt.detect = ImportTimer::seconds(ImportTimer::DETECT);
+    rt.insert = ImportTimer::seconds(ImportTimer::INSERT);
+
+    g_db->execute("DROP TABLE " + g_db->quote_field("bench_import"));
+    g_db_free();
+
+    return rt;
+}
+
+//! command line options
+enum { OPT_HELP, OPT_ROWS, OPT_KEYS, OPT_TEXT, OPT_NOISE, OPT_COMPRESS,
+       OPT_REPEAT, OPT_SEED, OPT_DIR, OPT_KEEP };
+
+static CSimpleOpt::SOption sopt_list[] = {
+    { OPT_HELP,     "-?", SO_NONE },
+    { OPT_HELP,     "-h", SO_NONE },
+    { OPT_ROWS,     "-n", SO_REQ_SEP },
+    { OPT_KEYS,     "-k", SO_REQ_SEP },
+    { OPT_TEXT,     "-t", SO_REQ_SEP },
+    { OPT_NOISE,    "-N", SO_REQ_SEP },
+    { OPT_COMPRESS, "-z", SO_REQ_SEP },
+    { OPT_REPEAT,   "-r", SO_REQ_SEP },
+    { OPT_SEED,     "-s", SO_REQ_SEP },
+    { OPT_DIR,      "-d", SO_REQ_SEP },
+    { OPT_KEEP,     "-K", SO_NONE },
+    SO_END_OF_OPTIONS
+};
+
+//! print command line usage
+static int print_usage(const std::string& progname)
+{
+    OUT("Usage: " << progname << " [options] [databases...] [-- import-options]" << std::endl <<
+        std::endl <<
+        "Imports a synthetic RESULT log into each database (default: sqlite)." << std::endl <<
+        std::endl <<
+        "Options: " << std::endl <<
+        "  -n <rows>   Number of RESULT lines (default 1000000)." << std::endl <<
+        "  -k <keys>   Number of keys per line (default 8)." << std::endl <<
+        "  -t <ratio>  Fraction of keys with text values (default 0.25)." << std::endl <<
+        "  -N <ratio>  Fraction of non-RESULT noise lines (default 0.1)." << std::endl <<
+        "  -z <type>   Compress log with gz, bz2 or xz." << std::endl <<
+        "  -r <num>    Repetitions, the fastest run is reported (default 3)." << std::endl <<
+        "  -s <seed>   Random seed (default 1)." << std::endl <<
+        "  -d <dir>    Directory of the generated log (default /tmp)." << std::endl <<
+        "  -K          Keep the generated log." << std::endl);
+
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[])
+{
+    GenParams gp;
+    unsigned int repeat = 3;
+    std::string dir = "/tmp";
+    bool keep = false;
+
+    // arguments after -- are passed to IMPORT-DATA
+    std::vector<std::string> import_args;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--") != 0) continue;
+        import_args.assign(argv + i + 1, argv + argc);
+        argc = i;
+        break;
+    }
+
+    CSimpleOpt args(argc, argv, sopt_list);
+
+    while (args.Next())
+    {
+        if (args.LastError() != SO_SUCCESS) {
+            OUT(argv[0] << ": invalid command line argument '" << args.OptionText() << "'");
+            return EXIT_FAILURE;
+        }
+
+        bool ok = true;
+
+        switch (args.OptionId())
+        {
+        case OPT_HELP: default:
+            return print_usage(argv[0]);
+
+        case OPT_ROWS:
+            ok = from_str(args.OptionArg(), gp.rows);
+            break;
+
+        case OPT_KEYS:
+            ok = from_str(args.OptionArg(), gp.keys) && gp.keys > 0;
+            break;
+
+        case OPT_TEXT:
+            ok = from_str(args.OptionArg(), gp.text_ratio) &&
+                 gp.text_ratio >= 0 && gp.text_ratio <= 1;
+            break;
+
+        case OPT_NOISE:
+            ok = from_str(args.OptionArg(), gp.noise_ratio) &&
+                 gp.noise_ratio >= 0 && gp.noise_ratio < 1;
+            break;
+
+        case OPT_COMPRESS:
+            gp.compress = args.OptionArg();
+            ok = (gp.compress == "gz" || gp.compress == "bz2" ||
+                  gp.compress == "xz");
+            break;
+
+        case OPT_REPEAT:
+            ok = from_str(args.OptionArg(), repeat) && repeat > 0;
+            break;
+
+        case OPT_SEED:
+            ok = from_str(args.OptionArg(), gp.seed);
+            break;
+
+        case OPT_DIR:
+            dir = args.OptionArg();
+            break;
+
+        case OPT_KEEP:
+            keep = true;
+            break;
+        }
+
+        if (!ok) {
+            OUT(argv[0] << ": invalid argument '" << args.OptionArg() << "'");
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::string> databases(args.Files(), args.Files() + args.FileCount());
+    if (databases.empty()) databases.push_back("sqlite");
+
+    try
+    {
+        std::string path = dir + "/bench_import-" + to_str(getpid()) + ".log";
+
+        GenStats gs;
+        std::string file = generate(gp, path, gs);
+
+        std::cout << "Generated " << file << ": " << gs.lines << " lines, "
+                  << gs.bytes / 1e6 << " MB uncompressed, "
+                  << gp.keys << " keys, text ratio " << gp.text_ratio
+                  << ", noise ratio " << gp.noise_ratio << std::endl;
+
+        std::vector<RunTimes> best(databases.size());
+
+        for (size_t d = 0; d < databases.size(); ++d)
+        {
+            for (unsigned int r = 0; r < repeat; ++r)
+            {
+                RunTimes rt = run_import(databases[d], import_args, file);
+                if (r == 0 || rt.total < best[d].total) best[d] = rt;
+            }
+        }
+
+        if (!keep) unlink(file.c_str());
+
+        // report fastest runs, phase times in seconds
+        printf("\n%-24s %12s %8s %8s %8s %8s %8s %8s\n",
+               "database", "lines/s", "MB/s", "total", "read", "parse",
+               "detect", "insert");
+
+        for (size_t d = 0; d < databases.size(); ++d)
+        {
+            const RunTimes& rt = best[d];
+            printf("%-24s %12.0f %8.2f %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+                   databases[d].c_str(), gs.lines / rt.total,
+                   gs.bytes / rt.total / 1e6, rt.total, rt.read(),
+                   rt.parse, rt.detect, rt.insert);
+        }
+
+        printf("\nread includes decompressing, splitting and caching lines. "
+               "With -j, parse and\ndetect sum the time of all threads.\n");
+    }
+    catch (std::runtime_error& e)
+    {
+        OUT(e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Import a file with -d -F, then append the same lines in another run and
+# check that the fingerprint file keeps them out of the table.
+#
+# usage: dedup.sh <sqlplot-tools> <scratch dir> <test.data>
+
+set -e
+
+TOOL=$1
+DIR=$2
+DATA=$3
+
+rm -rf "$DIR"
+mkdir -p "$DIR"
+touch "$DIR/test.db"
+
+# import with the fingerprint file and check the number of rows in the table
+import() {
+    rows=$1; shift
+    "$TOOL" import-data -D "sqlite:$DIR/test.db" -P -d -F "$DIR/dedup.fp" "$@"
+
+    printf '%% TABULAR SELECT COUNT(*) FROM test\n' > "$DIR/count.tex"
+    "$TOOL" -D "sqlite:$DIR/test.db" "$DIR/count.tex" -o "$DIR/count.out"
+
+    if ! grep -q "^$rows " "$DIR/count.out"; then
+        echo "expected $rows rows:"; cat "$DIR/count.out"; exit 1
+    fi
+}
+
+# duplicates within one run
+import 108 test "$DATA" "$DATA"
+
+# duplicates of the earlier run
+import 108 -A test "$DATA"
+
+# replacing the table also resets the fingerprint file
+import 108 test "$DATA"
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Follow a file, append data once and check that its rows are committed
+# without any further write or interrupt.
+#
+# usage: follow.sh <sqlplot-tools> <scratch dir> <test.data>
+
+set -e
+
+TOOL=$1
+DIR=$2
+DATA=$3
+
+rm -rf "$DIR"
+mkdir -p "$DIR"
+touch "$DIR/test.db" "$DIR/test.data"
+
+"$TOOL" import-data -D "sqlite:$DIR/test.db" -f follow "$DIR/*.data" \
+    > "$DIR/follow.log" 2>&1 &
+PID=$!
+
+# wait for the process to watch the directory
+i=0
+until grep -q "^Following" "$DIR/follow.log"; do
+    i=$((i + 1))
+    if [ $i -gt 100 ]; then cat "$DIR/follow.log"; kill $PID; exit 1; fi
+    sleep 0.1
+done
+
+cat "$DATA" >> "$DIR/test.data"
+
+# the batch must be committed on its own
+i=0
+until grep -q "^Committed 108 new rows" "$DIR/follow.log"; do
+    i=$((i + 1))
+    if [ $i -gt 100 ]; then cat "$DIR/follow.log"; kill $PID; exit 1; fi
+    sleep 0.1
+done
+
+kill -INT $PID
+wait $PID
+
+cat "$DIR/follow.log"
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Import a file incrementally, append to it, then truncate, rewrite and
+# replace it, and check that rows are never imported twice.
+#
+# usage: incremental.sh <sqlplot-tools> <scratch dir> <test.data>
+
+set -e
+
+TOOL=$1
+DIR=$2
+DATA=$3
+
+rm -rf "$DIR"
+mkdir -p "$DIR"
+touch "$DIR/test.db"
+
+# import incrementally and check the number of rows in the table
+import() {
+    "$TOOL" import-data -D "sqlite:$DIR/test.db" -P -I test "$DIR/test.data"
+
+    printf '%% TABULAR SELECT COUNT(*) FROM test\n' > "$DIR/count.tex"
+    "$TOOL" -D "sqlite:$DIR/test.db" "$DIR/count.tex" -o "$DIR/count.out"
+
+    if ! grep -q "^$1 " "$DIR/count.out"; then
+        echo "expected $1 rows:"; cat "$DIR/count.out"; exit 1
+    fi
+}
+
+cat "$DATA" > "$DIR/test.data"
+import 108
+
+# appended lines are added
+cat "$DATA" >> "$DIR/test.data"
+import 216
+
+# truncated file replaces all rows
+cat "$DATA" > "$DIR/test.data"
+import 108
+
+# rewritten file of the same size replaces all rows
+touch -t 200001010000 "$DIR/test.data"
+import 108
+
+# rotated file with a new inode replaces all rows
+cp "$DATA" "$DIR/test.new"
+mv "$DIR/test.new" "$DIR/test.data"
+import 108
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Serve imports on a Unix domain socket, send data from two clients and check
+# that their rows are committed and the socket is removed on interrupt.
+#
+# usage: serve.sh <sqlplot-tools> <scratch dir> <test.data>
+
+set -e
+
+TOOL=$1
+DIR=$2
+DATA=$3
+
+rm -rf "$DIR"
+mkdir -p "$DIR"
+touch "$DIR/test.db"
+
+"$TOOL" serve-import -D "sqlite:$DIR/test.db" serve "$DIR/import.sock" \
+    > "$DIR/serve.log" 2>&1 &
+PID=$!
+
+# wait until the log contains a line starting with the given text
+wait_log() {
+    i=0
+    until grep -q "^$1" "$DIR/serve.log"; do
+        i=$((i + 1))
+        if [ $i -gt 100 ]; then cat "$DIR/serve.log"; kill $PID; exit 1; fi
+        sleep 0.1
+    done
+}
+
+# send a file to the socket
+send() {
+    perl -MIO::Socket::UNIX -e '
+        my $s = IO::Socket::UNIX->new(Peer => $ARGV[0]) or die "connect: $!";
+        open(my $in, "<", $ARGV[1]) or die "open: $!";
+        print $s $_ while <$in>;
+        close($s);' "$DIR/import.sock" "$1"
+}
+
+wait_log "Serving"
+
+send "$DATA"
+wait_log "Committed 108 new rows"
+
+send "$DATA"
+wait_log "Committed 108 new rows from 0 clients, .* 216 in total"
+
+kill -INT $PID
+wait $PID
+
+grep -q "^Served 2 connections, imported 216 rows" "$DIR/serve.log"
+test ! -e "$DIR/import.sock"
+
+cat "$DIR/serve.log"